@@ -1,13 +1,13 @@
 #pragma once
 
 #include "runtime/KeyEvent.h"
+#include "Regex.h"
 #include <string>
 #include <optional>
-#include <regex>
 
 struct Filter {
   std::string string;
-  std::optional<std::regex> regex;
+  std::optional<Regex> regex;
 
   explicit operator bool() const { return !string.empty(); }
 
@@ -15,7 +15,7 @@ struct Filter {
     if (string.empty())
       return true;
     if (regex.has_value())
-      return std::regex_search(text, *regex);
+      return regex->search(text);
     return (substring ?
       text.find(string) != std::string::npos :
       text == string);
@@ -38,6 +38,9 @@ struct Command {
   KeySequence input;
   KeySequence default_mapping;
   std::vector<ContextMapping> context_mappings;
+  // where it was defined, filename is empty for the main file
+  int line_no;
+  std::string filename;
 };
 
 struct Action {
@@ -0,0 +1,16 @@
+
+#include "CreateStage.h"
+
+std::unique_ptr<Stage> create_stage(const Config& config) {
+  auto mappings = std::vector<Mapping>();
+  auto override_sets = std::vector<MappingOverrideSet>(config.contexts.size());
+  for (const auto& command : config.commands) {
+    for (const auto& context_mapping : command.context_mappings)
+      override_sets[static_cast<size_t>(context_mapping.context_index)]
+        .push_back({ static_cast<int>(mappings.size()),
+                     context_mapping.output });
+    mappings.push_back({ command.input, command.default_mapping });
+  }
+  return std::make_unique<Stage>(
+    std::move(mappings), std::move(override_sets));
+}
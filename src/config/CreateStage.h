@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Config.h"
+#include "runtime/Stage.h"
+#include <memory>
+
+// Creates a stage with the mappings of all commands and an override set
+// per context, which can be selected using Stage::activate_override_set.
+std::unique_ptr<Stage> create_stage(const Config& config);
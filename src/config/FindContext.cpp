@@ -0,0 +1,91 @@
+
+#include "FindContext.h"
+#include <algorithm>
+
+namespace {
+  const auto max_cache_size = 8u;
+
+  bool has_exact_class_filter(const Context& context) {
+    const auto& filter = context.window_class_filter;
+    return (filter && !filter.regex.has_value());
+  }
+} // namespace
+
+FindContext::FindContext(const Config& config)
+  : m_contexts(config.contexts) {
+
+  for (auto i = 0; i < static_cast<int>(m_contexts.size()); ++i) {
+    const auto& context = m_contexts[static_cast<size_t>(i)];
+    if (has_exact_class_filter(context))
+      m_contexts_by_class[context.window_class_filter.string].push_back(i);
+    else
+      m_contexts_any_class.push_back(i);
+
+    const auto& class_regex = context.window_class_filter.regex;
+    m_class_regex_indices.push_back(class_regex ?
+      m_class_regexes.add(*class_regex) : -1);
+
+    const auto& title_regex = context.window_title_filter.regex;
+    m_title_regex_indices.push_back(title_regex ?
+      m_title_regexes.add(*title_regex) : -1);
+  }
+}
+
+int FindContext::operator()(const std::string& window_class,
+                            const std::string& window_title) {
+  // move found entry to front of cache
+  const auto it = std::find_if(begin(m_cache), end(m_cache),
+    [&](const CacheEntry& entry) {
+      return (entry.window_class == window_class &&
+              entry.window_title == window_title);
+    });
+  if (it != end(m_cache)) {
+    std::rotate(begin(m_cache), it, std::next(it));
+    return m_cache.front().context_index;
+  }
+
+  // insert new entry at front, evicting the least recently used
+  const auto context_index = find(window_class, window_title);
+  if (m_cache.size() < max_cache_size)
+    m_cache.emplace_back();
+  std::rotate(begin(m_cache), std::prev(end(m_cache)), end(m_cache));
+  m_cache.front() = { window_class, window_title, context_index };
+  return context_index;
+}
+
+int FindContext::find(const std::string& window_class,
+    const std::string& window_title) const {
+  static const auto s_no_contexts = std::vector<int>();
+  const auto it = m_contexts_by_class.find(window_class);
+  const auto& by_class = (it != m_contexts_by_class.end() ?
+    it->second : s_no_contexts);
+  const auto& any_class = m_contexts_any_class;
+
+  // search all regular expressions once, when the first is evaluated
+  auto class_matched = std::vector<char>();
+  auto title_matched = std::vector<char>();
+  const auto matches = [](const Filter& filter, int regex_index,
+      const RegexSet& regexes, std::vector<char>& matched,
+      const std::string& text, bool substring) {
+    if (regex_index < 0)
+      return filter.matches(text, substring);
+    if (matched.empty())
+      regexes.search(text, &matched);
+    return (matched[static_cast<size_t>(regex_index)] != 0);
+  };
+
+  // merge both ascending lists of candidates, first match wins
+  auto a = by_class.begin();
+  auto b = any_class.begin();
+  while (a != by_class.end() || b != any_class.end()) {
+    const auto index = static_cast<size_t>(
+      (b == any_class.end() || (a != by_class.end() && *a < *b) ? *a++ : *b++));
+    const auto& context = m_contexts[index];
+    if (matches(context.window_class_filter, m_class_regex_indices[index],
+          m_class_regexes, class_matched, window_class, false) &&
+        matches(context.window_title_filter, m_title_regex_indices[index],
+          m_title_regexes, title_matched, window_title, true))
+      return static_cast<int>(index);
+  }
+  return -1;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Config.h"
+#include <unordered_map>
+
+// Resolves the context of a window. Contexts with an exact class filter are
+// indexed by class, so only the filters of candidate contexts are evaluated.
+// The regular expressions of all class and all title filters are each
+// combined, to evaluate them in a single pass.
+// The results of the recently queried windows are cached.
+class FindContext {
+public:
+  FindContext() = default;
+  explicit FindContext(const Config& config);
+
+  int operator()(const std::string& window_class,
+                 const std::string& window_title);
+
+private:
+  struct CacheEntry {
+    std::string window_class;
+    std::string window_title;
+    int context_index;
+  };
+
+  int find(const std::string& window_class,
+           const std::string& window_title) const;
+
+  std::vector<Context> m_contexts;
+  std::unordered_map<std::string, std::vector<int>> m_contexts_by_class;
+  std::vector<int> m_contexts_any_class;
+  RegexSet m_class_regexes;
+  RegexSet m_title_regexes;
+  std::vector<int> m_class_regex_indices;
+  std::vector<int> m_title_regex_indices;
+  std::vector<CacheEntry> m_cache;
+};
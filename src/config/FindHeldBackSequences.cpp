@@ -0,0 +1,38 @@
+
+#include "FindHeldBackSequences.h"
+#include "Key.h"
+#include <set>
+
+int find_first_match(const Stage& stage, const KeySequence& sequence,
+    MatchResult* result) {
+  auto match = MatchKeySequence();
+  for (auto index : stage.mapping_order()) {
+    const auto& mapping = stage.mappings()[static_cast<size_t>(index)];
+    *result = match(mapping.input, sequence);
+    if (*result != MatchResult::no_match)
+      return index;
+  }
+  *result = MatchResult::no_match;
+  return -1;
+}
+
+std::vector<HeldBackSequence> find_held_back_sequences(const Stage& stage) {
+  auto held_back = std::vector<HeldBackSequence>();
+  auto tried = std::set<std::string>();
+  auto prefix = KeySequence();
+  for (const auto& mapping : stage.mappings()) {
+    prefix.clear();
+    for (const auto& event : mapping.input) {
+      if (event.state == KeyState::Down && !prefix.empty() &&
+          tried.insert(format_key_sequence(prefix)).second) {
+        auto result = MatchResult{ };
+        const auto index = find_first_match(stage, prefix, &result);
+        if (result == MatchResult::might_match)
+          held_back.push_back({ prefix, index });
+      }
+      if (event.state == KeyState::Down || event.state == KeyState::Up)
+        prefix.push_back(event);
+    }
+  }
+  return held_back;
+}
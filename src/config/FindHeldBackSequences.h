@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Config.h"
+#include "runtime/Stage.h"
+
+struct HeldBackSequence {
+  KeySequence sequence;
+  // the first mapping which might match
+  int mapping_index;
+};
+
+// Returns the first mapping which matches or might match a sequence,
+// or -1 when none does.
+int find_first_match(const Stage& stage, const KeySequence& sequence,
+  MatchResult* result);
+
+// Returns the key sequences which are held back, because a mapping might
+// match when more keys follow. Tried are the keys pressed and released up
+// to each key press of an input expression, optional and not allowed keys
+// are omitted. Matching does not depend on the context, so mappings which
+// are only defined in a context hold back input in all contexts.
+std::vector<HeldBackSequence> find_held_back_sequences(const Stage& stage);
+
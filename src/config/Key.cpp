@@ -1,215 +1,349 @@
-
 #include "Key.h"
-#include <cctype>
-#include <cstring>
-#include <string>
-#include <algorithm>
-#include <vector>
+#include <array>
+#include <cstdint>
+#include <iterator>
 
-std::string_view get_key_name(const Key& key) {
-  switch (key) {
-    case Key::Escape:             return "Escape";
-    case Key::Digit1:             return "1";
-    case Key::Digit2:             return "2";
-    case Key::Digit3:             return "3";
-    case Key::Digit4:             return "4";
-    case Key::Digit5:             return "5";
-    case Key::Digit6:             return "6";
-    case Key::Digit7:             return "7";
-    case Key::Digit8:             return "8";
-    case Key::Digit9:             return "9";
-    case Key::Digit0:             return "0";
-    case Key::Minus:              return "Minus";
-    case Key::Equal:              return "Equal";
-    case Key::Backspace:          return "Backspace";
-    case Key::Tab:                return "Tab";
-    case Key::KeyQ:               return "Q";
-    case Key::KeyW:               return "W";
-    case Key::KeyE:               return "E";
-    case Key::KeyR:               return "R";
-    case Key::KeyT:               return "T";
-    case Key::KeyY:               return "Y";
-    case Key::KeyU:               return "U";
-    case Key::KeyI:               return "I";
-    case Key::KeyO:               return "O";
-    case Key::KeyP:               return "P";
-    case Key::BracketLeft:        return "BracketLeft";
-    case Key::BracketRight:       return "BracketRight";
-    case Key::Enter:              return "Enter";
-    case Key::ControlLeft:        return "ControlLeft";
-    case Key::KeyA:               return "A";
-    case Key::KeyS:               return "S";
-    case Key::KeyD:               return "D";
-    case Key::KeyF:               return "F";
-    case Key::KeyG:               return "G";
-    case Key::KeyH:               return "H";
-    case Key::KeyJ:               return "J";
-    case Key::KeyK:               return "K";
-    case Key::KeyL:               return "L";
-    case Key::Semicolon:          return "Semicolon";
-    case Key::Quote:              return "Quote";
-    case Key::Backquote:          return "Backquote";
-    case Key::ShiftLeft:          return "ShiftLeft";
-    case Key::Backslash:          return "Backslash";
-    case Key::KeyZ:               return "Z";
-    case Key::KeyX:               return "X";
-    case Key::KeyC:               return "C";
-    case Key::KeyV:               return "V";
-    case Key::KeyB:               return "B";
-    case Key::KeyN:               return "N";
-    case Key::KeyM:               return "M";
-    case Key::Comma:              return "Comma";
-    case Key::Period:             return "Period";
-    case Key::Slash:              return "Slash";
-    case Key::ShiftRight:         return "ShiftRight";
-    case Key::NumpadMultiply:     return "NumpadMultiply";
-    case Key::AltLeft:            return "AltLeft";
-    case Key::Space:              return "Space";
-    case Key::CapsLock:           return "CapsLock";
-    case Key::F1:                 return "F1";
-    case Key::F2:                 return "F2";
-    case Key::F3:                 return "F3";
-    case Key::F4:                 return "F4";
-    case Key::F5:                 return "F5";
-    case Key::F6:                 return "F6";
-    case Key::F7:                 return "F7";
-    case Key::F8:                 return "F8";
-    case Key::F9:                 return "F9";
-    case Key::F10:                return "F10";
-    case Key::NumLock:            return "NumLock";
-    case Key::ScrollLock:         return "ScrollLock";
-    case Key::Numpad7:            return "Numpad7";
-    case Key::Numpad8:            return "Numpad8";
-    case Key::Numpad9:            return "Numpad9";
-    case Key::NumpadSubtract:     return "NumpadSubtract";
-    case Key::Numpad4:            return "Numpad4";
-    case Key::Numpad5:            return "Numpad5";
-    case Key::Numpad6:            return "Numpad6";
-    case Key::NumpadAdd:          return "NumpadAdd";
-    case Key::Numpad1:            return "Numpad1";
-    case Key::Numpad2:            return "Numpad2";
-    case Key::Numpad3:            return "Numpad3";
-    case Key::Numpad0:            return "Numpad0";
-    case Key::NumpadDecimal:      return "NumpadDecimal";
-    case Key::IntlBackslash:      return "IntlBackslash";
-    case Key::F11:                return "F11";
-    case Key::F12:                return "F12";
-    case Key::IntlRo:             return "IntlRo";
-    case Key::Convert:            return "Convert";
-    case Key::KanaMode:           return "KanaMode";
-    case Key::NonConvert:         return "NonConvert";
-    case Key::NumpadEnter:        return "NumpadEnter";
-    case Key::ControlRight:       return "ControlRight";
-    case Key::NumpadDivide:       return "NumpadDivide";
-    case Key::PrintScreen:        return "PrintScreen";
-    case Key::AltRight:           return "AltRight";
-    case Key::Home:               return "Home";
-    case Key::ArrowUp:            return "ArrowUp";
-    case Key::PageUp:             return "PageUp";
-    case Key::ArrowLeft:          return "ArrowLeft";
-    case Key::ArrowRight:         return "ArrowRight";
-    case Key::End:                return "End";
-    case Key::ArrowDown:          return "ArrowDown";
-    case Key::PageDown:           return "PageDown";
-    case Key::Insert:             return "Insert";
-    case Key::Delete:             return "Delete";
-    case Key::Settings:           return "Settings";
-    case Key::BrightnessDown:     return "BrightnessDown";
-    case Key::BrightnessUp:       return "BrightnessUp";
-    case Key::DisplayToggleIntExt:return "DisplayToggleIntExt";
-    case Key::Prog3:              return "Prog3";
-    case Key::WLAN:               return "WLAN";
-    case Key::AudioVolumeMute:    return "AudioVolumeMute";
-    case Key::AudioVolumeDown:    return "AudioVolumeDown";
-    case Key::AudioVolumeUp:      return "AudioVolumeUp";
-    case Key::Power:              return "Power";
-    case Key::NumpadEqual:        return "NumpadEqual";
-    case Key::Pause:              return "Pause";
-    case Key::NumpadComma:        return "NumpadComma";
-    case Key::Lang1:              return "Lang1";
-    case Key::Lang2:              return "Lang2";
-    case Key::IntlYen:            return "IntlYen";
-    case Key::MetaLeft:           return "MetaLeft";
-    case Key::MetaRight:          return "MetaRight";
-    case Key::ContextMenu:        return "ContextMenu";
-    case Key::BrowserStop:        return "BrowserStop";
-    case Key::LaunchApp1:         return "LaunchApp1";
-    case Key::BrowserSearch:      return "BrowserSearch";
-    case Key::BrowserFavorites:   return "BrowserFavorites";
-    case Key::BrowserBack:        return "BrowserBack";
-    case Key::BrowserForward:     return "BrowserForward";
-    case Key::MediaTrackNext:     return "MediaTrackNext";
-    case Key::MediaPlayPause:     return "MediaPlayPause";
-    case Key::MediaTrackPrevious: return "MediaTrackPrevious";
-    case Key::MediaStop:          return "MediaStop";
-    case Key::BrowserRefresh:     return "BrowserRefresh";
-    case Key::F13:                return "F13";
-    case Key::F14:                return "F14";
-    case Key::F15:                return "F15";
-    case Key::F16:                return "F16";
-    case Key::F17:                return "F17";
-    case Key::F18:                return "F18";
-    case Key::F19:                return "F19";
-    case Key::F20:                return "F20";
-    case Key::F21:                return "F21";
-    case Key::F22:                return "F22";
-    case Key::F23:                return "F23";
-    case Key::F24:                return "F24";
-
-    case Key::Any:      return "Any";
-    case Key::Shift:    return "Shift";
-    case Key::Control:  return "Control";
-    case Key::Meta:     return "Meta";
-
-    case Key::Virtual0: return "Virtual0";
-    case Key::Virtual1: return "Virtual1";
-    case Key::Virtual2: return "Virtual2";
-    case Key::Virtual3: return "Virtual3";
-    case Key::Virtual4: return "Virtual4";
-    case Key::Virtual5: return "Virtual5";
-    case Key::Virtual6: return "Virtual6";
-    case Key::Virtual7: return "Virtual7";
-    case Key::Virtual8: return "Virtual8";
-    case Key::Virtual9: return "Virtual9";
-
-    case Key::None:
-      break;
+namespace {
+  struct KeyName {
+    Key key;
+    std::string_view name;
+  };
+
+  constexpr KeyName key_names[] = {
+    { Key::Escape, "Escape" },
+    { Key::Digit1, "1" },
+    { Key::Digit2, "2" },
+    { Key::Digit3, "3" },
+    { Key::Digit4, "4" },
+    { Key::Digit5, "5" },
+    { Key::Digit6, "6" },
+    { Key::Digit7, "7" },
+    { Key::Digit8, "8" },
+    { Key::Digit9, "9" },
+    { Key::Digit0, "0" },
+    { Key::Minus, "Minus" },
+    { Key::Equal, "Equal" },
+    { Key::Backspace, "Backspace" },
+    { Key::Tab, "Tab" },
+    { Key::KeyQ, "Q" },
+    { Key::KeyW, "W" },
+    { Key::KeyE, "E" },
+    { Key::KeyR, "R" },
+    { Key::KeyT, "T" },
+    { Key::KeyY, "Y" },
+    { Key::KeyU, "U" },
+    { Key::KeyI, "I" },
+    { Key::KeyO, "O" },
+    { Key::KeyP, "P" },
+    { Key::BracketLeft, "BracketLeft" },
+    { Key::BracketRight, "BracketRight" },
+    { Key::Enter, "Enter" },
+    { Key::ControlLeft, "ControlLeft" },
+    { Key::KeyA, "A" },
+    { Key::KeyS, "S" },
+    { Key::KeyD, "D" },
+    { Key::KeyF, "F" },
+    { Key::KeyG, "G" },
+    { Key::KeyH, "H" },
+    { Key::KeyJ, "J" },
+    { Key::KeyK, "K" },
+    { Key::KeyL, "L" },
+    { Key::Semicolon, "Semicolon" },
+    { Key::Quote, "Quote" },
+    { Key::Backquote, "Backquote" },
+    { Key::ShiftLeft, "ShiftLeft" },
+    { Key::Backslash, "Backslash" },
+    { Key::KeyZ, "Z" },
+    { Key::KeyX, "X" },
+    { Key::KeyC, "C" },
+    { Key::KeyV, "V" },
+    { Key::KeyB, "B" },
+    { Key::KeyN, "N" },
+    { Key::KeyM, "M" },
+    { Key::Comma, "Comma" },
+    { Key::Period, "Period" },
+    { Key::Slash, "Slash" },
+    { Key::ShiftRight, "ShiftRight" },
+    { Key::NumpadMultiply, "NumpadMultiply" },
+    { Key::AltLeft, "AltLeft" },
+    { Key::Space, "Space" },
+    { Key::CapsLock, "CapsLock" },
+    { Key::F1, "F1" },
+    { Key::F2, "F2" },
+    { Key::F3, "F3" },
+    { Key::F4, "F4" },
+    { Key::F5, "F5" },
+    { Key::F6, "F6" },
+    { Key::F7, "F7" },
+    { Key::F8, "F8" },
+    { Key::F9, "F9" },
+    { Key::F10, "F10" },
+    { Key::NumLock, "NumLock" },
+    { Key::ScrollLock, "ScrollLock" },
+    { Key::Numpad7, "Numpad7" },
+    { Key::Numpad8, "Numpad8" },
+    { Key::Numpad9, "Numpad9" },
+    { Key::NumpadSubtract, "NumpadSubtract" },
+    { Key::Numpad4, "Numpad4" },
+    { Key::Numpad5, "Numpad5" },
+    { Key::Numpad6, "Numpad6" },
+    { Key::NumpadAdd, "NumpadAdd" },
+    { Key::Numpad1, "Numpad1" },
+    { Key::Numpad2, "Numpad2" },
+    { Key::Numpad3, "Numpad3" },
+    { Key::Numpad0, "Numpad0" },
+    { Key::NumpadDecimal, "NumpadDecimal" },
+    { Key::IntlBackslash, "IntlBackslash" },
+    { Key::F11, "F11" },
+    { Key::F12, "F12" },
+    { Key::IntlRo, "IntlRo" },
+    { Key::Convert, "Convert" },
+    { Key::KanaMode, "KanaMode" },
+    { Key::NonConvert, "NonConvert" },
+    { Key::NumpadEnter, "NumpadEnter" },
+    { Key::ControlRight, "ControlRight" },
+    { Key::NumpadDivide, "NumpadDivide" },
+    { Key::PrintScreen, "PrintScreen" },
+    { Key::AltRight, "AltRight" },
+    { Key::Home, "Home" },
+    { Key::ArrowUp, "ArrowUp" },
+    { Key::PageUp, "PageUp" },
+    { Key::ArrowLeft, "ArrowLeft" },
+    { Key::ArrowRight, "ArrowRight" },
+    { Key::End, "End" },
+    { Key::ArrowDown, "ArrowDown" },
+    { Key::PageDown, "PageDown" },
+    { Key::Insert, "Insert" },
+    { Key::Delete, "Delete" },
+    { Key::Settings, "Settings" },
+    { Key::BrightnessDown, "BrightnessDown" },
+    { Key::BrightnessUp, "BrightnessUp" },
+    { Key::DisplayToggleIntExt, "DisplayToggleIntExt" },
+    { Key::Prog3, "Prog3" },
+    { Key::WLAN, "WLAN" },
+    { Key::AudioVolumeMute, "AudioVolumeMute" },
+    { Key::AudioVolumeDown, "AudioVolumeDown" },
+    { Key::AudioVolumeUp, "AudioVolumeUp" },
+    { Key::Power, "Power" },
+    { Key::NumpadEqual, "NumpadEqual" },
+    { Key::Pause, "Pause" },
+    { Key::NumpadComma, "NumpadComma" },
+    { Key::Lang1, "Lang1" },
+    { Key::Lang2, "Lang2" },
+    { Key::IntlYen, "IntlYen" },
+    { Key::MetaLeft, "MetaLeft" },
+    { Key::MetaRight, "MetaRight" },
+    { Key::ContextMenu, "ContextMenu" },
+    { Key::BrowserStop, "BrowserStop" },
+    { Key::LaunchApp1, "LaunchApp1" },
+    { Key::BrowserSearch, "BrowserSearch" },
+    { Key::BrowserFavorites, "BrowserFavorites" },
+    { Key::BrowserBack, "BrowserBack" },
+    { Key::BrowserForward, "BrowserForward" },
+    { Key::MediaTrackNext, "MediaTrackNext" },
+    { Key::MediaPlayPause, "MediaPlayPause" },
+    { Key::MediaTrackPrevious, "MediaTrackPrevious" },
+    { Key::MediaStop, "MediaStop" },
+    { Key::BrowserRefresh, "BrowserRefresh" },
+    { Key::F13, "F13" },
+    { Key::F14, "F14" },
+    { Key::F15, "F15" },
+    { Key::F16, "F16" },
+    { Key::F17, "F17" },
+    { Key::F18, "F18" },
+    { Key::F19, "F19" },
+    { Key::F20, "F20" },
+    { Key::F21, "F21" },
+    { Key::F22, "F22" },
+    { Key::F23, "F23" },
+    { Key::F24, "F24" },
+
+    { Key::Any, "Any" },
+    { Key::Shift, "Shift" },
+    { Key::Control, "Control" },
+    { Key::Meta, "Meta" },
+
+    { Key::Virtual0, "Virtual0" },
+    { Key::Virtual1, "Virtual1" },
+    { Key::Virtual2, "Virtual2" },
+    { Key::Virtual3, "Virtual3" },
+    { Key::Virtual4, "Virtual4" },
+    { Key::Virtual5, "Virtual5" },
+    { Key::Virtual6, "Virtual6" },
+    { Key::Virtual7, "Virtual7" },
+    { Key::Virtual8, "Virtual8" },
+    { Key::Virtual9, "Virtual9" },
+  };
+  constexpr auto key_count = std::size(key_names);
+
+  constexpr uint32_t hash_key(Key key) {
+    return static_cast<uint32_t>(key) * 0x9E3779B1u;
   }
-  return { };
-}
 
-Key get_key_by_name(std::string_view name) {
-  // generate vector of all key name/key pairs, sorted by name
-  static const auto s_key_map =
-    []() {
-      auto map = std::vector<std::pair<std::string_view, Key>>();
-      map.reserve(200);
-
-      for (auto key_code = 1; key_code < 0xFFFF; ++key_code) {
-        const auto key = static_cast<Key>(key_code);
-        auto name = get_key_name(key);
-        if (!name.empty())
-          map.emplace_back(name, key);
+  constexpr uint32_t hash_name(std::string_view name) {
+    // FNV-1a
+    auto hash = 2166136261u;
+    for (auto c : name)
+      hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    return hash;
+  }
+
+  // A perfect hash table, which is built at compile time by hash and
+  // displace: the keys are distributed to buckets by the upper bits of
+  // their hash and for each bucket a value is searched, which displaces
+  // all its keys to free slots when combined with the lower bits.
+  class KeyNameTable {
+  public:
+    static constexpr auto table_size = 512u;
+    static constexpr auto bucket_count = 128u;
+    static constexpr auto empty_slot = uint8_t{ 0xFF };
+    static_assert(key_count < empty_slot);
+
+    template<typename GetHash>
+    constexpr KeyNameTable(GetHash get_hash) {
+      auto hashes = std::array<uint32_t, key_count>{ };
+      for (auto i = 0u; i < key_count; ++i)
+        hashes[i] = get_hash(key_names[i]);
+
+      // sort keys by bucket
+      auto bucket_ends = std::array<unsigned int, bucket_count + 1>{ };
+      for (auto hash : hashes)
+        ++bucket_ends[bucket(hash) + 1];
+      auto max_bucket_size = 0u;
+      for (auto b = 0u; b < bucket_count; ++b) {
+        if (bucket_ends[b + 1] > max_bucket_size)
+          max_bucket_size = bucket_ends[b + 1];
+        bucket_ends[b + 1] += bucket_ends[b];
+      }
+      auto keys = std::array<uint8_t, key_count>{ };
+      auto bucket_fill = bucket_ends;
+      for (auto i = 0u; i < key_count; ++i)
+        keys[bucket_fill[bucket(hashes[i])]++] = static_cast<uint8_t>(i);
+
+      for (auto& slot : m_slots)
+        slot = empty_slot;
+
+      // place the keys of the largest buckets first
+      for (auto size = max_bucket_size; size > 0; --size)
+        for (auto b = 0u; b < bucket_count; ++b)
+          if (bucket_ends[b + 1] - bucket_ends[b] == size &&
+              !place_bucket(b, hashes, &keys[bucket_ends[b]],
+                &keys[0] + bucket_ends[b + 1]))
+            return;
+      m_valid = true;
+    }
+
+    constexpr bool valid() const { return m_valid; }
+
+    // returns index in key_names or key_count
+    constexpr size_t find(uint32_t hash) const {
+      const auto index = m_slots[slot(hash)];
+      return (index == empty_slot ? key_count : index);
+    }
+
+  private:
+    static constexpr unsigned int bucket(uint32_t hash) {
+      return (hash >> 16) % bucket_count;
+    }
+
+    constexpr unsigned int slot(uint32_t hash) const {
+      return (hash ^ m_displacements[bucket(hash)]) & (table_size - 1);
+    }
+
+    constexpr bool place_bucket(unsigned int b,
+        const std::array<uint32_t, key_count>& hashes,
+        const uint8_t* begin, const uint8_t* end) {
+      for (auto d = 0u; d < table_size; ++d) {
+        m_displacements[b] = static_cast<uint16_t>(d);
+        auto it = begin;
+        for (; it != end; ++it) {
+          auto& slot_index = m_slots[slot(hashes[*it])];
+          if (slot_index != empty_slot)
+            break;
+          slot_index = *it;
+        }
+        if (it == end)
+          return true;
+
+        // undo placement of keys of bucket
+        while (it != begin)
+          m_slots[slot(hashes[*--it])] = empty_slot;
       }
-      std::sort(begin(map), end(map),
-        [](const auto& a, const auto& b) { return a.first < b.first; });
+      return false;
+    }
+
+    std::array<uint16_t, bucket_count> m_displacements{ };
+    std::array<uint8_t, table_size> m_slots{ };
+    bool m_valid{ };
+  };
+
+  constexpr auto key_table = KeyNameTable(
+    [](const KeyName& key_name) { return hash_key(key_name.key); });
+  constexpr auto name_table = KeyNameTable(
+    [](const KeyName& key_name) { return hash_name(key_name.name); });
+  static_assert(key_table.valid() && name_table.valid());
+
+  constexpr size_t find_key(Key key) {
+    const auto index = key_table.find(hash_key(key));
+    return (index < key_count && key_names[index].key == key ?
+      index : key_count);
+  }
+
+  constexpr size_t find_name(std::string_view name) {
+    const auto index = name_table.find(hash_name(name));
+    return (index < key_count && key_names[index].name == name ?
+      index : key_count);
+  }
 
-      return map;
-    }();
+  constexpr bool key_tables_consistent() {
+    for (auto i = 0u; i < key_count; ++i)
+      if (find_key(key_names[i].key) != i ||
+          find_name(key_names[i].name) != i)
+        return false;
+    return (find_key(Key::None) == key_count &&
+            find_name("") == key_count &&
+            find_name("None") == key_count);
+  }
+  static_assert(key_tables_consistent(),
+    "key names and key codes have to be unique");
+} // namespace
 
+std::string_view get_key_name(const Key& key) {
+  const auto index = find_key(key);
+  return (index < key_count ? key_names[index].name : std::string_view());
+}
+
+std::string format_key_sequence(const KeySequence& sequence) {
+  auto string = std::string();
+  for (const auto& event : sequence) {
+    if (!string.empty())
+      string += ' ';
+    switch (event.state) {
+      case KeyState::Up: string += '-'; break;
+      case KeyState::Down: string += '+'; break;
+      case KeyState::Not: string += '!'; break;
+      case KeyState::UpAsync: string += '~'; break;
+      case KeyState::DownAsync: string += '*'; break;
+      case KeyState::OutputOnRelease: string += '^'; break;
+      case KeyState::DownMatched: string += '#'; break;
+    }
+    if (is_action_key(event.key))
+      string += "Action" + std::to_string(event.key - first_action_key);
+    else
+      string += get_key_name(static_cast<Key>(event.key));
+  }
+  return string;
+}
+
+Key get_key_by_name(std::string_view name) {
   // allow to omit Key and Digit prefixes
   if (name.size() > 3 && name.substr(0, 3) == "Key")
     name = name.substr(3);
   else if (name.size() > 5 && name.substr(0, 5) == "Digit")
     name = name.substr(5);
 
-  // binary search for key name
-  auto it = std::lower_bound(cbegin(s_key_map), cend(s_key_map), name,
-    [](const auto& kv, const auto& name) { return kv.first < name; });
-  if (it != cend(s_key_map) && it->first == name)
-    return it->second;
-
-  return Key::None;
+  const auto index = find_name(name);
+  return (index < key_count ? key_names[index].key : Key::None);
 }
 
 KeyCode operator*(Key key) {
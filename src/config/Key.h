@@ -261,5 +261,7 @@ enum class Key : KeyCode {
 };
 
 std::string_view get_key_name(const Key& key);
+// e.g. "+ShiftLeft +A -A ~ShiftLeft", action keys are named "Action<n>"
+std::string format_key_sequence(const KeySequence& sequence);
 Key get_key_by_name(std::string_view key_name);
 KeyCode operator*(Key key);
@@ -4,10 +4,11 @@
 #include "Key.h"
 #include <cassert>
 #include <cctype>
+#include <filesystem>
+#include <fstream>
 #include <istream>
 #include <algorithm>
 #include <iterator>
-#include <sstream>
 
 namespace {
 
@@ -25,6 +26,28 @@ namespace {
     return str;
   }
 
+  // skips an optionally quoted filename,
+  // returns false when the quote is not terminated
+  template<typename ForwardIt>
+  bool skip_filename(ForwardIt* it, ForwardIt end) {
+    if (skip(it, end, "'") || skip(it, end, "\"")) {
+      const char mark[2] = { *(*it - 1), '\0' };
+      return skip_until(it, end, mark);
+    }
+    while (*it != end && !std::isspace(static_cast<unsigned char>(**it)) &&
+           **it != '#' && **it != ';')
+      ++(*it);
+    return true;
+  }
+
+  // a line which continues with '>>' after the filename maps a
+  // command or macro named include
+  template<typename ForwardIt>
+  bool is_include_directive(ForwardIt it, ForwardIt end) {
+    skip_filename(&it, end);
+    return !skip_until(&it, end, ">>");
+  }
+
   bool contains(const KeySequence& sequence, KeyCode key) {
     return std::find_if(cbegin(sequence), cend(sequence),
       [&](const KeyEvent& event) {
@@ -65,38 +88,89 @@ namespace {
       replace_not_key(mapping.output, both, left, right);
   }
 
-  void remove_mappings_to_context(Command& command, int context_index, bool apply_default) {
-    for (auto it = begin(command.context_mappings); it != end(command.context_mappings); ) {
-      auto& mapping = *it;
-      if (mapping.context_index == context_index) {
-        if (apply_default)
-          command.default_mapping = mapping.output;
-        it = command.context_mappings.erase(it);
+  void remove_mappings_to_contexts(Command& command,
+      const std::vector<int>& context_indices,
+      const std::vector<bool>& apply_default) {
+    auto& mappings = command.context_mappings;
+    auto it = begin(mappings);
+    for (auto& mapping : mappings) {
+      const auto context_index = mapping.context_index;
+      if (context_indices[context_index] < 0) {
+        if (apply_default[context_index])
+          command.default_mapping = std::move(mapping.output);
       }
       else {
         // reduce indices pointing to following contexts
-        if (mapping.context_index > context_index)
-          --mapping.context_index;
+        mapping.context_index = context_indices[context_index];
+        if (&*it != &mapping)
+          *it = std::move(mapping);
         ++it;
       }
     }
+    mappings.erase(it, end(mappings));
   }
 
   std::string generate_unique_name_from_sequence(const KeySequence& sequence) {
-    auto ss = std::stringstream();
-    ss << '#';
-    for (const auto& event : sequence)
-      ss << event.key << '/' << static_cast<int>(event.state) << ',';
-    return ss.str();
+    // fixed number of hex digits per event, so the name is unique
+    const auto hex_digits = "0123456789ABCDEF";
+    auto name = std::string(1 + sequence.size() * 6, '#');
+    auto it = std::next(name.begin());
+    for (const auto& event : sequence) {
+      for (auto shift = 12; shift >= 0; shift -= 4)
+        *it++ = hex_digits[(event.key >> shift) & 0xF];
+      *it++ = hex_digits[static_cast<int>(event.state) & 0xF];
+      *it++ = ',';
+    }
+    return name;
+  }
+
+  bool read_file(const std::string& filename, std::string* text) {
+    auto is = std::ifstream(filename, std::ios::binary);
+    if (!is.good())
+      return false;
+    text->assign(std::istreambuf_iterator<char>(is),
+                 std::istreambuf_iterator<char>());
+    return !is.bad();
+  }
+
+  std::string normalize_path(const std::filesystem::path& path) {
+    auto ec = std::error_code();
+    const auto canonical = std::filesystem::weakly_canonical(path, ec);
+    return (ec ? path.lexically_normal() : canonical).string();
+  }
+
+  size_t hash_text(std::string_view text) {
+    return std::hash<std::string_view>()(text);
+  }
+
+  void hash_combine(size_t* hash, size_t value) {
+    *hash ^= value + 0x9E3779B9u + (*hash << 6) + (*hash >> 2);
   }
 } // namespace
 
 Config ParseConfig::operator()(std::istream& is, bool add_default_mappings) {
+  const auto text = std::string(std::istreambuf_iterator<char>(is),
+                                std::istreambuf_iterator<char>());
+  return (*this)(std::string_view(text), add_default_mappings);
+}
+
+Config ParseConfig::operator()(std::string_view text,
+    bool add_default_mappings, const std::string& filename) {
   m_line_no = 0;
   m_config.commands.clear();
   m_config.contexts.clear();
+  m_config.actions.clear();
+  m_command_indices.clear();
   m_commands_mapped.clear();
   m_macros.clear();
+  m_macros_hash = { };
+  m_command_names_hash = { };
+  m_filename.reset();
+  m_include_stack.assign(1, filename.empty() ? filename :
+    normalize_path(filename));
+  m_recording_depth = 0;
+  m_operations.clear();
+  m_included_files.clear();
 
   if (add_default_mappings) {
     // add mappings for immediately passing on common modifiers
@@ -104,35 +178,39 @@ Config ParseConfig::operator()(std::istream& is, bool add_default_mappings) {
       add_mapping( { { *key, KeyState::Down } }, { { *key, KeyState::Down } });
   }
 
-  auto line = std::string();
-  while (is.good()) {
-    std::getline(is, line);
-    ++m_line_no;
-    parse_line(cbegin(line), cend(line));
-  }
+  parse_text(text);
 
   // check if there is a mapping for each command (to reduce typing errors)
-  for (const auto& kv : m_commands_mapped)
-    if (!kv.second)
-      throw ParseError("Command '" + kv.first + "' was not mapped");
+  auto unmapped = std::add_pointer_t<const std::string>{ };
+  for (auto i = 0u; i < m_commands_mapped.size(); ++i)
+    if (!m_commands_mapped[i] &&
+        (!unmapped || m_config.commands[i].name < *unmapped))
+      unmapped = &m_config.commands[i].name;
+  if (unmapped)
+    throw ParseError("Command '" + *unmapped + "' was not mapped");
 
   // remove contexts of other systems
   // and apply contexts without class and title filter immediately
+  auto& contexts = m_config.contexts;
+  auto context_indices = std::vector<int>(contexts.size(), -1);
+  auto apply_default = std::vector<bool>(contexts.size());
   auto context_index = 0;
-  for (auto it = begin(m_config.contexts); it != end(m_config.contexts); ) {
-    auto& context = *it;
+  for (auto i = 0u; i < contexts.size(); ++i) {
+    const auto& context = contexts[i];
     if (!context.system_filter_matched ||
         (!context.window_class_filter &&
-         !context.window_title_filter)) {
-      const auto apply_default = context.system_filter_matched;
-      for (auto& command : m_config.commands)
-        remove_mappings_to_context(command, context_index, apply_default);
-      it = m_config.contexts.erase(it);
-    }
-    else {
-      ++it;
-      ++context_index;
-    }
+         !context.window_title_filter))
+      apply_default[i] = context.system_filter_matched;
+    else
+      context_indices[i] = context_index++;
+  }
+  if (context_index != static_cast<int>(contexts.size())) {
+    for (auto& command : m_config.commands)
+      remove_mappings_to_contexts(command, context_indices, apply_default);
+    auto i = 0;
+    contexts.erase(std::remove_if(begin(contexts), end(contexts),
+      [&](const Context&) { return context_indices[i++] < 0; }),
+      end(contexts));
   }
 
   replace_logical_modifiers(*Key::Shift, *Key::ShiftLeft, *Key::ShiftRight);
@@ -143,8 +221,22 @@ Config ParseConfig::operator()(std::istream& is, bool add_default_mappings) {
 }
 
 void ParseConfig::error(std::string message) {
-  throw ParseError(std::move(message) +
-    " in line " + std::to_string(m_line_no));
+  message += " in line " + std::to_string(m_line_no);
+  if (m_filename)
+    message += " of '" + *m_filename + "'";
+  throw ParseError(std::move(message));
+}
+
+void ParseConfig::parse_text(std::string_view text) {
+  m_line_no = 0;
+  for (auto it = cbegin(text); ; ++it) {
+    const auto line_end = std::find(it, cend(text), '\n');
+    ++m_line_no;
+    parse_line(it, line_end);
+    if (line_end == cend(text))
+      break;
+    it = line_end;
+  }
 }
 
 void ParseConfig::parse_line(It it, const It end) {
@@ -168,8 +260,10 @@ void ParseConfig::parse_line(It it, const It end) {
       if (has_command(first_ident))
         parse_mapping(std::move(first_ident), it, end);
       else
-        parse_command_and_mapping(
-          cbegin(first_ident), cend(first_ident), it, end);
+        parse_command_and_mapping(begin, begin + first_ident.size(), it, end);
+    }
+    else if (first_ident == "include" && is_include_directive(it, end)) {
+      parse_include(it, end);
     }
     else {
       if (!skip_until(&it, end, ">>"))
@@ -199,11 +293,10 @@ Filter ParseConfig::read_filter(It* it, const It end) {
       if (std::distance(prev, *it) % 2 == 0)
         break;
     }
-    auto type = std::regex::ECMAScript;
     const auto expr = std::string(begin, *it);
-    if (skip(it, end, "i"))
-      type |= std::regex::icase;
-    return Filter{ expr, std::regex(expr.substr(1, expr.size() - 2), type) };
+    const auto icase = skip(it, end, "i");
+    return Filter{ expr, Regex(
+      std::string_view(expr).substr(1, expr.size() - 2), icase) };
   }
   else {
     // a string
@@ -262,43 +355,180 @@ void ParseConfig::parse_context(It* it, const It end) {
       error("Missing ']'");
   }
 
-  m_config.contexts.push_back({
+  auto operation = Operation();
+  operation.type = Operation::Type::Context;
+  operation.context = {
     system_filter_matched,
     std::move(class_filter),
     std::move(title_filter)
-  });
+  };
+  apply(std::move(operation));
+}
+
+void ParseConfig::parse_include(It it, const It end) {
+  const auto begin = it;
+  if (!skip_filename(&it, end))
+    error("Unterminated string");
+  auto filename = std::string(begin, it);
+  if (it != begin && (*begin == '\'' || *begin == '"'))
+    filename = filename.substr(1, filename.size() - 2);
+  if (filename.empty())
+    error("Filename expected");
+
+  skip_space_and_comments(&it, end);
+  if (it != end)
+    error("Unexpected '" + std::string(it, end) + "'");
+
+  include_file(std::move(filename));
+}
+
+void ParseConfig::include_file(std::string filename) {
+  // resolve path relative to including file
+  auto path = std::filesystem::path(filename);
+  if (path.is_relative())
+    path = std::filesystem::path(m_include_stack.back()).parent_path() / path;
+  filename = normalize_path(path);
+
+  if (std::find(m_include_stack.begin(), m_include_stack.end(),
+        filename) != m_include_stack.end())
+    error("Recursive include of '" + filename + "'");
+
+  auto text = std::string();
+  if (!read_file(filename, &text))
+    error("Reading '" + filename + "' failed");
+  const auto content_hash = hash_text(text);
+
+  // replay cached fragment when it can not have a different result
+  const auto state_hash = get_state_hash();
+  const auto cached = m_fragment_cache.find(filename);
+  if (cached != m_fragment_cache.end() &&
+      cached->second.state_hash == state_hash &&
+      replay_fragment(cached->second, content_hash))
+    return;
+
+  const auto files_begin = m_included_files.size();
+  const auto operations_begin = m_operations.size();
+  m_included_files.push_back({ filename, content_hash });
+  const auto line_no = m_line_no;
+  auto including_filename = std::move(m_filename);
+  m_filename = std::make_shared<const std::string>(filename);
+  m_include_stack.push_back(filename);
+  ++m_recording_depth;
+
+  parse_text(text);
+
+  --m_recording_depth;
+  m_include_stack.pop_back();
+  m_filename = std::move(including_filename);
+  m_line_no = line_no;
+
+  auto& fragment = m_fragment_cache[filename];
+  fragment.state_hash = state_hash;
+  fragment.files.assign(m_included_files.begin() + files_begin,
+    m_included_files.end());
+  fragment.operations.assign(m_operations.begin() + operations_begin,
+    m_operations.end());
+  if (!m_recording_depth)
+    m_operations.clear();
+}
+
+bool ParseConfig::replay_fragment(const Fragment& fragment,
+    size_t content_hash) {
+  // check that neither the file nor the files it included changed
+  auto text = std::string();
+  for (const auto& file : fragment.files) {
+    const auto hash = (&file == &fragment.files.front() ? content_hash :
+      read_file(file.filename, &text) ? hash_text(text) : size_t{ });
+    if (hash != file.content_hash)
+      return false;
+  }
+  m_included_files.insert(m_included_files.end(),
+    fragment.files.begin(), fragment.files.end());
+
+  const auto line_no = m_line_no;
+  auto including_filename = std::move(m_filename);
+  for (const auto& operation : fragment.operations) {
+    m_line_no = operation.line_no;
+    m_filename = operation.filename;
+    apply(operation);
+  }
+  m_filename = std::move(including_filename);
+  m_line_no = line_no;
+  return true;
+}
+
+size_t ParseConfig::get_state_hash() const {
+  // state parsing depends on: macros, command names and action indices
+  auto hash = m_macros_hash;
+  hash_combine(&hash, m_command_names_hash);
+  hash_combine(&hash, m_config.actions.size());
+  return hash;
+}
+
+void ParseConfig::apply(Operation operation) {
+  if (m_recording_depth) {
+    operation.filename = m_filename;
+    operation.line_no = m_line_no;
+    m_operations.push_back(operation);
+  }
+
+  switch (operation.type) {
+    case Operation::Type::Macro:
+      return set_macro(std::move(operation.name), std::move(operation.value));
+    case Operation::Type::Command:
+      return add_command(std::move(operation.input), std::move(operation.name));
+    case Operation::Type::Mapping:
+      return add_mapping(std::move(operation.input), std::move(operation.output));
+    case Operation::Type::CommandMapping:
+      return add_mapping(std::move(operation.name), std::move(operation.output));
+    case Operation::Type::Context:
+      return m_config.contexts.push_back(std::move(operation.context));
+    case Operation::Type::Action:
+      return m_config.actions.push_back({ std::move(operation.value) });
+  }
 }
 
 void ParseConfig::parse_mapping(std::string name, It begin, It end) {
-  add_mapping(std::move(name), parse_output(begin, end));
+  auto operation = Operation();
+  operation.type = Operation::Type::CommandMapping;
+  operation.name = std::move(name);
+  operation.output = parse_output(begin, end);
+  apply(std::move(operation));
 }
 
-bool is_ident(const std::string& string) {
+bool is_ident(std::string_view string) {
   auto it = string.begin();
   const auto end = string.end();
   skip_ident(&it, end);
   return (it == end);
 }
 
-std::string ParseConfig::parse_command_name(It it, It end) const {
+std::string ParseConfig::parse_command_name(It it, It end) {
   skip_space(&it, end);
-  auto ident = preprocess_ident(read_ident(&it, end));
+  const auto begin = it;
+  skip_ident(&it, end);
+  const auto ident = preprocess_ident(to_string_view(begin, it));
   skip_space(&it, end);
   if (it != end ||
       !is_ident(ident) ||
       get_key_by_name(ident) != Key::None)
     return { };
-  return ident;
+  return std::string(ident);
 }
 
 void ParseConfig::parse_command_and_mapping(const It in_begin, const It in_end,
     const It out_begin, const It out_end) {
-  auto input = parse_input(in_begin, in_end);
-  auto command_name = parse_command_name(out_begin, out_end);
-  if (!command_name.empty())
-    add_command(std::move(input), std::move(command_name));
-  else
-    add_mapping(std::move(input), parse_output(out_begin, out_end));
+  auto operation = Operation();
+  operation.input = parse_input(in_begin, in_end);
+  operation.name = parse_command_name(out_begin, out_end);
+  if (!operation.name.empty()) {
+    operation.type = Operation::Type::Command;
+  }
+  else {
+    operation.type = Operation::Type::Mapping;
+    operation.output = parse_output(out_begin, out_end);
+  }
+  apply(std::move(operation));
 }
 
 KeySequence ParseConfig::parse_input(It it, It end) {
@@ -314,7 +544,10 @@ KeySequence ParseConfig::parse_input(It it, It end) {
 KeyCode ParseConfig::add_terminal_command_action(std::string_view command) {
   const auto action_key_code =
     static_cast<KeyCode>(first_action_key + m_config.actions.size());
-  m_config.actions.push_back({ std::string(command) });
+  auto operation = Operation();
+  operation.type = Operation::Type::Action;
+  operation.value = std::string(command);
+  apply(std::move(operation));
   return action_key_code;
 }
 
@@ -338,18 +571,41 @@ void ParseConfig::parse_macro(std::string name, It it, const It end) {
   // we can safely trim here, because macro cannot have a terminal command
   It trimmed = end;
   trim_comment(it, &trimmed);
-  m_macros[std::move(name)] = preprocess(it, trimmed);
+  auto operation = Operation();
+  operation.type = Operation::Type::Macro;
+  operation.name = std::move(name);
+  operation.value = std::string(preprocess(it, trimmed));
+  apply(std::move(operation));
+}
+
+void ParseConfig::set_macro(std::string name, std::string value) {
+  const auto hash_macro = [](const auto& macro) {
+    auto hash = hash_text(macro.first);
+    hash_combine(&hash, hash_text(macro.second));
+    return hash;
+  };
+  auto it = m_macros.find(name);
+  if (it != m_macros.end()) {
+    m_macros_hash ^= hash_macro(*it);
+    it->second = std::move(value);
+  }
+  else {
+    it = m_macros.emplace(std::move(name), std::move(value)).first;
+  }
+  m_macros_hash ^= hash_macro(*it);
 }
 
-std::string ParseConfig::preprocess_ident(std::string ident) const {
+std::string_view ParseConfig::preprocess_ident(std::string_view ident) const {
   const auto macro = m_macros.find(ident);
   if (macro != cend(m_macros))
     return macro->second;
   return ident;
 }
 
-std::string ParseConfig::preprocess(It it, const It end) const {
-  auto result = std::string();
+std::string_view ParseConfig::preprocess(It it, const It end) {
+  // expand macros into a buffer, which is reused for each line
+  auto& result = m_preprocess_buffer;
+  result.clear();
   // remove comments
   skip_space_and_comments(&it, end);
 
@@ -362,7 +618,7 @@ std::string ParseConfig::preprocess(It it, const It end) const {
     skip_ident(&it, end);
     if (begin != it) {
       // match read ident
-      result.append(preprocess_ident(std::string(begin, it)));
+      result.append(preprocess_ident(to_string_view(begin, it)));
     }
     else {
       // output single character
@@ -372,10 +628,20 @@ std::string ParseConfig::preprocess(It it, const It end) const {
   return result;
 }
 
+Command* ParseConfig::find_command(const std::string& name) {
+  // the index refers to the first command with the name
+  const auto it = m_command_indices.find(name);
+  if (it == m_command_indices.end())
+    return nullptr;
+  return &m_config.commands[it->second];
+}
+
+std::string ParseConfig::get_filename() const {
+  return (m_filename ? *m_filename : std::string());
+}
+
 bool ParseConfig::has_command(const std::string& name) const {
-  const auto& commands = m_config.commands;
-  return (std::find_if(cbegin(commands), cend(commands),
-    [&](const Command& c) { return c.name == name; }) != cend(commands));
+  return (m_command_indices.count(name) != 0);
 }
 
 void ParseConfig::add_command(KeySequence input, std::string name) {
@@ -385,8 +651,11 @@ void ParseConfig::add_command(KeySequence input, std::string name) {
   if (has_command(name))
     error("Duplicate command '" + name + "'");
 
-  m_config.commands.push_back({ name, std::move(input), {}, {} });
-  m_commands_mapped[std::move(name)] = false;
+  m_command_indices.emplace(name, static_cast<int>(m_config.commands.size()));
+  m_command_names_hash ^= hash_text(name);
+  m_config.commands.push_back({ std::move(name), std::move(input), {}, {},
+    m_line_no, get_filename() });
+  m_commands_mapped.push_back(false);
 }
 
 void ParseConfig::add_mapping(KeySequence input, KeySequence output) {
@@ -395,15 +664,20 @@ void ParseConfig::add_mapping(KeySequence input, KeySequence output) {
   auto name = generate_unique_name_from_sequence(input);
   if (m_config.contexts.empty()) {
     // creating mapping in default context, set default output expression
-    m_config.commands.push_back({ std::move(name), std::move(input), std::move(output), {} });
+    m_command_indices.emplace(name, static_cast<int>(m_config.commands.size()));
+    m_config.commands.push_back({ std::move(name), std::move(input),
+      std::move(output), {}, m_line_no, get_filename() });
+    m_commands_mapped.push_back(true);
   }
   else if (m_config.contexts.back().system_filter_matched) {
     // mapping sequence in context, try to override existing command
-    if (!std::count_if(m_config.commands.begin(), m_config.commands.end(),
-          [&](const Command& command) { return command.name == name; })) {
+    if (!has_command(name)) {
       // create command with forwarding default mapping
       const auto default_mapping = KeySequence{ { any_key, KeyState::Down } };
-      m_config.commands.push_back({ name, std::move(input), std::move(default_mapping), {} });
+      m_command_indices.emplace(name, static_cast<int>(m_config.commands.size()));
+      m_config.commands.push_back({ name, std::move(input),
+        std::move(default_mapping), {}, m_line_no, get_filename() });
+      m_commands_mapped.push_back(false);
     }
     add_mapping(std::move(name), std::move(output));
   }
@@ -411,10 +685,8 @@ void ParseConfig::add_mapping(KeySequence input, KeySequence output) {
 
 void ParseConfig::add_mapping(std::string name, KeySequence output) {
   assert(!name.empty());
-  const auto it = std::find_if(
-    begin(m_config.commands), end(m_config.commands),
-    [&](const Command& command) { return command.name == name; });
-  if (it == cend(m_config.commands))
+  const auto it = find_command(name);
+  if (!it)
     error("Unknown command '" + name + "'");
 
   if (!m_config.contexts.empty()) {
@@ -431,25 +703,29 @@ void ParseConfig::add_mapping(std::string name, KeySequence output) {
       error("Duplicate mapping of '" + name + "'");
     it->default_mapping = std::move(output);
   }
-  m_commands_mapped[name] = true;
+  m_commands_mapped[std::distance(m_config.commands.data(), it)] = true;
 }
 
 void ParseConfig::replace_logical_modifiers(KeyCode both, KeyCode left,
     KeyCode right) {
-  auto& commands = m_config.commands;
-  for (auto it = begin(commands); it != end(commands); ) {
+  auto commands = std::vector<Command>();
+  commands.reserve(m_config.commands.size());
+  for (auto& command : m_config.commands) {
     // replace !Shift with !LeftShift !RightShift
-    replace_not_modifier(*it, both, left, right);
+    replace_not_modifier(command, both, left, right);
 
-    if (contains(it->input, both)) {
+    if (contains(command.input, both)) {
       // duplicate command and replace the logical with a physical key
-      it = commands.insert(it, *it);
-      replace_modifier(*it++, both, left);
-      replace_modifier(*it++, both, right);
+      commands.push_back(command);
+      replace_modifier(commands.back(), both, left);
+      commands.push_back(std::move(command));
+      replace_modifier(commands.back(), both, right);
     }
     else {
       // still convert all logical to physical keys in output
-      replace_modifier(*it++, both, left);
+      commands.push_back(std::move(command));
+      replace_modifier(commands.back(), both, left);
     }
   }
+  m_config.commands = std::move(commands);
 }
@@ -5,38 +5,91 @@
 #include "ParseKeySequence.h"
 #include <iosfwd>
 #include <map>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
 
 class ParseConfig {
 public:
+  struct File {
+    std::string filename;
+    size_t content_hash;
+  };
+
   Config operator()(std::istream& is, bool add_default_mappings = true);
+  // relative includes are resolved against the directory of filename
+  Config operator()(std::string_view text, bool add_default_mappings = true,
+    const std::string& filename = { });
+
+  // files included by last parsed configuration
+  const std::vector<File>& included_files() const { return m_included_files; }
 
 private:
-  using It = std::string::const_iterator;
+  using It = std::string_view::const_iterator;
+
+  // included files are parsed to a list of operations, which are replayed
+  // as long as the file and the state they were parsed in did not change
+  struct Operation {
+    enum class Type { Macro, Command, Mapping, CommandMapping, Context, Action };
+    Type type;
+    std::shared_ptr<const std::string> filename;
+    int line_no;
+    std::string name;
+    std::string value;
+    KeySequence input;
+    KeySequence output;
+    Context context;
+  };
+
+  struct Fragment {
+    size_t state_hash;
+    std::vector<File> files;
+    std::vector<Operation> operations;
+  };
 
   [[noreturn]] void error(std::string message);
+  void parse_text(std::string_view text);
   void parse_line(It begin, It end);
+  void parse_include(It begin, It end);
+  void include_file(std::string filename);
+  bool replay_fragment(const Fragment& fragment, size_t content_hash);
+  void apply(Operation operation);
+  size_t get_state_hash() const;
   void parse_context(It* begin, It end);
   void parse_macro(std::string name, It begin, It end);
   void parse_mapping(std::string name, It begin, It end);
-  std::string parse_command_name(It begin, It end) const;
+  std::string parse_command_name(It begin, It end);
   void parse_command_and_mapping(It in_begin, It in_end,
                                  It out_begin, It out_end);
   KeySequence parse_input(It begin, It end);
   KeySequence parse_output(It begin, It end);
-  std::string preprocess_ident(std::string ident) const;
-  std::string preprocess(It begin, It end) const;
+  std::string_view preprocess_ident(std::string_view ident) const;
+  std::string_view preprocess(It begin, It end);
   void replace_logical_modifiers(KeyCode both, KeyCode left, KeyCode right);
   Filter read_filter(It* it, It end);
   KeyCode add_terminal_command_action(std::string_view command);
 
+  std::string get_filename() const;
+  Command* find_command(const std::string& name);
   bool has_command(const std::string& name) const;
   void add_command(KeySequence input, std::string name);
   void add_mapping(KeySequence input, KeySequence output);
   void add_mapping(std::string name, KeySequence output);
+  void set_macro(std::string name, std::string value);
 
   int m_line_no{ };
+  std::shared_ptr<const std::string> m_filename;
+  std::vector<std::string> m_include_stack;
+  int m_recording_depth{ };
+  std::vector<Operation> m_operations;
+  std::vector<File> m_included_files;
+  std::unordered_map<std::string, Fragment> m_fragment_cache;
+  size_t m_macros_hash{ };
+  size_t m_command_names_hash{ };
   Config m_config;
-  std::map<std::string, std::string> m_macros;
+  std::map<std::string, std::string, std::less<>> m_macros;
+  std::string m_preprocess_buffer;
   ParseKeySequence m_parse_sequence;
-  std::map<std::string, bool> m_commands_mapped;
+  std::unordered_map<std::string, int> m_command_indices;
+  std::vector<bool> m_commands_mapped;
 };
@@ -5,7 +5,7 @@
 #include <algorithm>
 
 KeySequence ParseKeySequence::operator()(
-    const std::string& str, bool is_input,
+    std::string_view str, bool is_input,
     AddTerminalCommand add_terminal_command) {
 
   m_is_input = is_input;
@@ -16,7 +16,10 @@ KeySequence ParseKeySequence::operator()(
 
   parse(cbegin(str), cend(str));
 
-  return std::move(m_sequence);
+  // keep capacity of buffer and return sequence with exact size
+  auto sequence = KeySequence();
+  sequence.assign(cbegin(m_sequence), cend(m_sequence));
+  return sequence;
 }
 
 void ParseKeySequence::add_key_to_sequence(KeyCode key_code, KeyState state) {
@@ -75,14 +78,16 @@ void ParseKeySequence::remove_any_up_from_end() {
 }
 
 KeyCode ParseKeySequence::read_key(It* it, const It end) {
-  auto key_name = read_ident(it, end);
+  const auto begin = *it;
+  skip_ident(it, end);
+  const auto key_name = to_string_view(begin, *it);
   if (key_name.empty()) {
     const char at = *(*it == end ? std::prev(*it) : *it);
     throw ParseError("Key name expected at '" + std::string(1, at) + "'");
   }
   const auto key = get_key_by_name(key_name);
   if (key == Key::None)
-    throw ParseError("Invalid key '" + key_name + "'");
+    throw ParseError("Invalid key '" + std::string(key_name) + "'");
   return *key;
 }
 
@@ -119,7 +124,7 @@ void ParseKeySequence::parse(It it, const It end) {
           --level;
       }
       add_key_to_sequence(m_add_terminal_command(
-          std::string_view(&*begin, std::distance(begin, it) - 1)),
+          to_string_view(begin, std::prev(it))),
         KeyState::Down);
     }
     else if (skip(&it, end, "^")) {
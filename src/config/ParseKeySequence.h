@@ -3,6 +3,7 @@
 #include "runtime/KeyEvent.h"
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <functional>
 
 // Here are some examples for input and output expressions. Each example
@@ -43,11 +44,11 @@ class ParseKeySequence {
 public:
   using AddTerminalCommand = std::function<KeyCode(std::string_view)>;
 
-  KeySequence operator()(const std::string& str, bool is_input,
+  KeySequence operator()(std::string_view str, bool is_input,
     AddTerminalCommand add_terminal_command = { });
 
 private:
-  using It = std::string::const_iterator;
+  using It = std::string_view::const_iterator;
 
   void parse(It it, const It end);
   KeyCode read_key(It* it, const It end);
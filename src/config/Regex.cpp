@@ -0,0 +1,608 @@
+
+#include "Regex.h"
+#include <cctype>
+#include <cstdlib>
+#include <iterator>
+
+namespace {
+  using Op = RegexProgram::Op;
+  using CharClass = RegexProgram::CharClass;
+
+  // limit size of programs (repetition counts are expanded)
+  const auto max_instructions = 5000;
+
+  struct Unsupported { };
+
+  struct Node {
+    enum class Type {
+      Empty, Class, Concat, Alternate, Repeat,
+      LineBegin, LineEnd, WordBoundary, NotWordBoundary
+    };
+    Type type;
+    int class_index;
+    int min;
+    int max; // -1 when unbounded
+    std::vector<Node> children;
+  };
+
+  CharClass make_class(char from, char to) {
+    auto result = CharClass();
+    for (auto c = static_cast<unsigned char>(from);
+         c <= static_cast<unsigned char>(to); ++c)
+      result.set(c);
+    return result;
+  }
+
+  CharClass make_class(char c) {
+    return make_class(c, c);
+  }
+
+  CharClass digit_class() {
+    return make_class('0', '9');
+  }
+
+  CharClass word_class() {
+    return make_class('a', 'z') | make_class('A', 'Z') |
+           make_class('0', '9') | make_class('_');
+  }
+
+  CharClass space_class() {
+    return make_class(' ') | make_class('\t', '\r');
+  }
+
+  bool is_word_char(char c) {
+    return (std::isalnum(static_cast<unsigned char>(c)) || c == '_');
+  }
+
+  CharClass fold_case(CharClass set) {
+    for (auto c = 'a'; c <= 'z'; ++c) {
+      const auto upper = static_cast<char>(std::toupper(c));
+      const auto either = (set.test(static_cast<unsigned char>(c)) ||
+                           set.test(static_cast<unsigned char>(upper)));
+      set.set(static_cast<unsigned char>(c), either);
+      set.set(static_cast<unsigned char>(upper), either);
+    }
+    return set;
+  }
+
+  int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    throw Unsupported();
+  }
+
+  class Parser {
+  public:
+    Parser(std::string_view pattern, bool icase,
+        std::vector<CharClass>* classes)
+      : m_it(pattern.begin()), m_end(pattern.end()),
+        m_icase(icase), m_classes(*classes) {
+    }
+
+    Node operator()() {
+      auto node = parse_disjunction();
+      if (m_it != m_end)
+        throw Unsupported();
+      return node;
+    }
+
+  private:
+    bool at(char c) const {
+      return (m_it != m_end && *m_it == c);
+    }
+
+    bool skip(char c) {
+      if (!at(c))
+        return false;
+      ++m_it;
+      return true;
+    }
+
+    char next() {
+      if (m_it == m_end)
+        throw Unsupported();
+      return *m_it++;
+    }
+
+    Node add_class(CharClass set) {
+      if (m_icase)
+        set = fold_case(set);
+      m_classes.push_back(set);
+      return { Node::Type::Class,
+        static_cast<int>(m_classes.size()) - 1, 0, 0, { } };
+    }
+
+    Node parse_disjunction() {
+      auto node = Node{ Node::Type::Alternate, 0, 0, 0, { } };
+      node.children.push_back(parse_alternative());
+      while (skip('|'))
+        node.children.push_back(parse_alternative());
+      if (node.children.size() == 1)
+        return std::move(node.children.front());
+      return node;
+    }
+
+    Node parse_alternative() {
+      auto node = Node{ Node::Type::Concat, 0, 0, 0, { } };
+      while (m_it != m_end && !at('|') && !at(')'))
+        node.children.push_back(parse_term());
+      return node;
+    }
+
+    Node parse_term() {
+      if (skip('^'))
+        return { Node::Type::LineBegin, 0, 0, 0, { } };
+      if (skip('$'))
+        return { Node::Type::LineEnd, 0, 0, 0, { } };
+
+      auto atom = parse_atom();
+      auto min = 0;
+      auto max = 0;
+      if (skip('*')) {
+        min = 0;
+        max = -1;
+      }
+      else if (skip('+')) {
+        min = 1;
+        max = -1;
+      }
+      else if (skip('?')) {
+        min = 0;
+        max = 1;
+      }
+      else if (skip('{')) {
+        min = parse_number();
+        max = min;
+        if (skip(','))
+          max = (at('}') ? -1 : parse_number());
+        if (!skip('}') || (max >= 0 && max < min))
+          throw Unsupported();
+      }
+      else {
+        return atom;
+      }
+      // lazy quantifiers do not change whether there is a match
+      skip('?');
+
+      auto node = Node{ Node::Type::Repeat, 0, min, max, { } };
+      node.children.push_back(std::move(atom));
+      return node;
+    }
+
+    int parse_number() {
+      auto value = 0;
+      if (m_it == m_end || !std::isdigit(static_cast<unsigned char>(*m_it)))
+        throw Unsupported();
+      while (m_it != m_end && std::isdigit(static_cast<unsigned char>(*m_it))) {
+        value = value * 10 + (*m_it++ - '0');
+        if (value > max_instructions)
+          throw Unsupported();
+      }
+      return value;
+    }
+
+    Node parse_atom() {
+      const auto c = next();
+      switch (c) {
+        case '.':
+          return add_class(~(make_class('\n') | make_class('\r')));
+
+        case '(': {
+          if (skip('?')) {
+            // only non-capturing groups (no lookahead)
+            if (!skip(':'))
+              throw Unsupported();
+          }
+          auto node = parse_disjunction();
+          if (!skip(')'))
+            throw Unsupported();
+          return node;
+        }
+
+        case '[':
+          return add_class(parse_class());
+
+        case '\\':
+          return parse_atom_escape();
+
+        case '*': case '+': case '?': case '{': case '}':
+        case ')': case ']': case '|':
+          throw Unsupported();
+
+        default:
+          return add_class(make_class(c));
+      }
+    }
+
+    Node parse_atom_escape() {
+      const auto c = next();
+      switch (c) {
+        case 'b': return { Node::Type::WordBoundary, 0, 0, 0, { } };
+        case 'B': return { Node::Type::NotWordBoundary, 0, 0, 0, { } };
+      }
+      return add_class(parse_class_escape(c, false));
+    }
+
+    CharClass parse_class_escape(char c, bool in_class) {
+      switch (c) {
+        case 'd': return digit_class();
+        case 'D': return ~digit_class();
+        case 'w': return word_class();
+        case 'W': return ~word_class();
+        case 's': return space_class();
+        case 'S': return ~space_class();
+      }
+      return make_class(parse_character_escape(c, in_class));
+    }
+
+    char parse_character_escape(char c, bool in_class) {
+      switch (c) {
+        case 't': return '\t';
+        case 'n': return '\n';
+        case 'v': return '\v';
+        case 'f': return '\f';
+        case 'r': return '\r';
+        case 'b':
+          if (in_class)
+            return '\b';
+          break;
+        case '0':
+          if (m_it == m_end || !std::isdigit(static_cast<unsigned char>(*m_it)))
+            return '\0';
+          break;
+        case 'x': {
+          const auto high = hex_value(next());
+          return static_cast<char>(high * 16 + hex_value(next()));
+        }
+        case 'u': {
+          auto value = 0;
+          for (auto i = 0; i < 4; ++i)
+            value = value * 16 + hex_value(next());
+          // only ASCII is unambiguous
+          if (value < 0x80)
+            return static_cast<char>(value);
+          break;
+        }
+        default:
+          // identity escapes of non-word characters
+          if (!is_word_char(c) && static_cast<unsigned char>(c) < 0x80)
+            return c;
+          break;
+      }
+      // backreferences, control escapes...
+      throw Unsupported();
+    }
+
+    CharClass parse_class() {
+      const auto negate = skip('^');
+      auto set = CharClass();
+      while (!skip(']')) {
+        auto is_range_bound = true;
+        auto from = char{ };
+        auto c = next();
+        if (c == '\\') {
+          c = next();
+          const auto escape = parse_class_escape(c, true);
+          if (escape.count() == 1) {
+            from = static_cast<char>(find_first(escape));
+          }
+          else {
+            set |= escape;
+            is_range_bound = false;
+          }
+        }
+        else if (c == '[') {
+          // no POSIX classes
+          throw Unsupported();
+        }
+        else {
+          from = c;
+        }
+
+        if (at('-') && std::next(m_it) != m_end && *std::next(m_it) != ']') {
+          ++m_it;
+          if (!is_range_bound)
+            throw Unsupported();
+          auto to = next();
+          if (to == '\\') {
+            const auto escape = parse_class_escape(next(), true);
+            if (escape.count() != 1)
+              throw Unsupported();
+            to = static_cast<char>(find_first(escape));
+          }
+          else if (to == '[') {
+            throw Unsupported();
+          }
+          if (static_cast<unsigned char>(to) < static_cast<unsigned char>(from))
+            throw Unsupported();
+          set |= make_class(from, to);
+        }
+        else if (is_range_bound) {
+          set.set(static_cast<unsigned char>(from));
+        }
+      }
+      // fold case before negating
+      if (m_icase)
+        set = fold_case(set);
+      return (negate ? ~set : set);
+    }
+
+    static size_t find_first(const CharClass& set) {
+      for (auto i = size_t{ }; i < set.size(); ++i)
+        if (set.test(i))
+          return i;
+      return 0;
+    }
+
+    std::string_view::const_iterator m_it;
+    const std::string_view::const_iterator m_end;
+    const bool m_icase;
+    std::vector<CharClass>& m_classes;
+  };
+
+  class Compiler {
+  public:
+    explicit Compiler(std::vector<RegexProgram::Instruction>* instructions)
+      : m_instructions(*instructions) {
+    }
+
+    void operator()(const Node& node) {
+      compile(node);
+    }
+
+  private:
+    int emit(Op op, int x = 0, int y = 0) {
+      if (static_cast<int>(m_instructions.size()) >= max_instructions)
+        throw Unsupported();
+      m_instructions.push_back({ op, x, y });
+      return static_cast<int>(m_instructions.size()) - 1;
+    }
+
+    int here() const {
+      return static_cast<int>(m_instructions.size());
+    }
+
+    void compile(const Node& node) {
+      switch (node.type) {
+        case Node::Type::Empty: break;
+        case Node::Type::Class: emit(Op::Class, node.class_index); break;
+        case Node::Type::LineBegin: emit(Op::LineBegin); break;
+        case Node::Type::LineEnd: emit(Op::LineEnd); break;
+        case Node::Type::WordBoundary: emit(Op::WordBoundary); break;
+        case Node::Type::NotWordBoundary: emit(Op::NotWordBoundary); break;
+
+        case Node::Type::Concat:
+          for (const auto& child : node.children)
+            compile(child);
+          break;
+
+        case Node::Type::Alternate: {
+          // split to each alternative, all jump to end
+          auto jumps = std::vector<int>();
+          for (auto i = 0u; i < node.children.size(); ++i) {
+            const auto last = (i + 1 == node.children.size());
+            const auto split = (last ? -1 : emit(Op::Split));
+            if (split >= 0)
+              m_instructions[split].x = here();
+            compile(node.children[i]);
+            if (!last)
+              jumps.push_back(emit(Op::Jump));
+            if (split >= 0)
+              m_instructions[split].y = here();
+          }
+          for (auto jump : jumps)
+            m_instructions[jump].x = here();
+          break;
+        }
+
+        case Node::Type::Repeat: {
+          const auto& child = node.children.front();
+          for (auto i = 0; i < node.min; ++i)
+            compile(child);
+
+          if (node.max < 0) {
+            // loop: split body, end; body; jump loop
+            const auto split = emit(Op::Split);
+            m_instructions[split].x = here();
+            compile(child);
+            emit(Op::Jump, split);
+            m_instructions[split].y = here();
+          }
+          else {
+            // optional repetitions all skip to end
+            auto splits = std::vector<int>();
+            for (auto i = node.min; i < node.max; ++i) {
+              const auto split = emit(Op::Split);
+              m_instructions[split].x = here();
+              splits.push_back(split);
+              compile(child);
+            }
+            for (auto split : splits)
+              m_instructions[split].y = here();
+          }
+          break;
+        }
+      }
+    }
+
+    std::vector<RegexProgram::Instruction>& m_instructions;
+  };
+
+  // appends expression to program, returns false when it is not supported
+  bool compile(std::string_view pattern, bool icase, RegexProgram* program) {
+    const auto instructions_size = program->instructions.size();
+    const auto classes_size = program->classes.size();
+    try {
+      auto node = Parser(pattern, icase, &program->classes)();
+      const auto start = static_cast<int>(program->instructions.size());
+      Compiler(&program->instructions)(node);
+      program->instructions.push_back({ Op::Match,
+        static_cast<int>(program->starts.size()), 0 });
+      program->starts.push_back(start);
+      return true;
+    }
+    catch (const Unsupported&) {
+      program->instructions.resize(instructions_size);
+      program->classes.resize(classes_size);
+      return false;
+    }
+  }
+} // namespace
+
+void RegexProgram::search(std::string_view text,
+    std::vector<char>* matched) const {
+  auto& result = *matched;
+  result.assign(starts.size(), 0);
+  auto remaining = starts.size();
+
+  // stamp per instruction, to add each only once per position
+  auto visited = std::vector<size_t>(instructions.size(), 0);
+  auto current = std::vector<int>();
+  auto next = std::vector<int>();
+  auto stack = std::vector<int>();
+
+  const auto add_thread = [&](std::vector<int>& list, int pc, size_t pos) {
+    stack.push_back(pc);
+    while (!stack.empty()) {
+      pc = stack.back();
+      stack.pop_back();
+      auto& stamp = visited[static_cast<size_t>(pc)];
+      if (stamp == pos + 1)
+        continue;
+      stamp = pos + 1;
+
+      const auto& instruction = instructions[static_cast<size_t>(pc)];
+      switch (instruction.op) {
+        case Op::Class:
+          list.push_back(pc);
+          break;
+        case Op::Split:
+          stack.push_back(instruction.y);
+          stack.push_back(instruction.x);
+          break;
+        case Op::Jump:
+          stack.push_back(instruction.x);
+          break;
+        case Op::Match:
+          if (!result[static_cast<size_t>(instruction.x)]) {
+            result[static_cast<size_t>(instruction.x)] = 1;
+            --remaining;
+          }
+          break;
+        case Op::LineBegin:
+          if (pos == 0)
+            stack.push_back(pc + 1);
+          break;
+        case Op::LineEnd:
+          if (pos == text.size())
+            stack.push_back(pc + 1);
+          break;
+        case Op::WordBoundary:
+        case Op::NotWordBoundary: {
+          const auto before = (pos > 0 && is_word_char(text[pos - 1]));
+          const auto after = (pos < text.size() && is_word_char(text[pos]));
+          if ((before != after) == (instruction.op == Op::WordBoundary))
+            stack.push_back(pc + 1);
+          break;
+        }
+      }
+    }
+  };
+
+  for (auto pos = size_t{ }; remaining; ++pos) {
+    // search for a match starting at each position
+    for (auto i = 0u; i < starts.size(); ++i)
+      if (!result[i])
+        add_thread(current, starts[i], pos);
+
+    if (pos == text.size())
+      break;
+
+    const auto c = static_cast<unsigned char>(text[pos]);
+    for (auto pc : current) {
+      const auto& instruction = instructions[static_cast<size_t>(pc)];
+      if (classes[static_cast<size_t>(instruction.x)].test(c))
+        add_thread(next, pc + 1, pos + 1);
+    }
+    current.swap(next);
+    next.clear();
+  }
+}
+
+Regex::Regex(std::string_view pattern, bool icase) {
+  auto program = std::make_shared<RegexProgram>();
+  if (compile(pattern, icase, program.get())) {
+    m_program = std::move(program);
+  }
+  else {
+    auto type = std::regex::ECMAScript;
+    if (icase)
+      type |= std::regex::icase;
+    m_fallback = std::make_shared<std::regex>(
+      pattern.begin(), pattern.end(), type);
+  }
+}
+
+bool Regex::search(std::string_view text) const {
+  if (m_fallback)
+    return std::regex_search(text.begin(), text.end(), *m_fallback);
+
+  auto matched = std::vector<char>();
+  m_program->search(text, &matched);
+  return matched.front();
+}
+
+int RegexSet::add(const Regex& regex) {
+  const auto index = m_count++;
+  if (regex.m_fallback) {
+    m_fallbacks.emplace_back(index, regex.m_fallback);
+    return index;
+  }
+
+  // append program, offsetting instruction and class indices
+  const auto& program = *regex.m_program;
+  const auto instruction_offset = static_cast<int>(m_program.instructions.size());
+  const auto class_offset = static_cast<int>(m_program.classes.size());
+  for (auto instruction : program.instructions) {
+    switch (instruction.op) {
+      case Op::Class:
+        instruction.x += class_offset;
+        break;
+      case Op::Split:
+        instruction.x += instruction_offset;
+        instruction.y += instruction_offset;
+        break;
+      case Op::Jump:
+        instruction.x += instruction_offset;
+        break;
+      case Op::Match:
+        instruction.x = static_cast<int>(m_program.starts.size());
+        break;
+      default:
+        break;
+    }
+    m_program.instructions.push_back(instruction);
+  }
+  m_program.classes.insert(m_program.classes.end(),
+    program.classes.begin(), program.classes.end());
+  m_program.starts.push_back(program.starts.front() + instruction_offset);
+  m_program_indices.push_back(index);
+  return index;
+}
+
+void RegexSet::search(std::string_view text, std::vector<char>* matched) const {
+  auto& result = *matched;
+  result.assign(static_cast<size_t>(m_count), 0);
+
+  if (!m_program.starts.empty()) {
+    auto program_matched = std::vector<char>();
+    m_program.search(text, &program_matched);
+    for (auto i = 0u; i < program_matched.size(); ++i)
+      result[static_cast<size_t>(m_program_indices[i])] = program_matched[i];
+  }
+
+  for (const auto& [index, regex] : m_fallbacks)
+    result[static_cast<size_t>(index)] =
+      std::regex_search(text.begin(), text.end(), *regex);
+}
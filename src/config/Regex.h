@@ -0,0 +1,70 @@
+#pragma once
+
+#include <bitset>
+#include <memory>
+#include <regex>
+#include <string_view>
+#include <vector>
+
+// A program for a non-backtracking virtual machine, which executes one or
+// more regular expressions at once in time linear to the text length.
+struct RegexProgram {
+  enum class Op : uint8_t {
+    Class,           // consume character contained in class x
+    Split,           // continue at x and y
+    Jump,            // continue at x
+    Match,           // expression x matched
+    LineBegin,
+    LineEnd,
+    WordBoundary,
+    NotWordBoundary,
+  };
+  struct Instruction {
+    Op op;
+    int x;
+    int y;
+  };
+  using CharClass = std::bitset<256>;
+
+  std::vector<Instruction> instructions;
+  std::vector<CharClass> classes;
+  std::vector<int> starts;
+
+  // sets matched[i] when expression i matches somewhere in text
+  void search(std::string_view text, std::vector<char>* matched) const;
+};
+
+// Supports the subset of ECMAScript regular expressions, which is commonly
+// used in context filters: literals, character classes, alternation, groups,
+// anchors and repetition. For expressions with other constructs (e.g.
+// backreferences or lookahead) it falls back to std::regex.
+class Regex {
+public:
+  Regex(std::string_view pattern, bool icase);
+
+  bool search(std::string_view text) const;
+  bool is_fallback() const { return static_cast<bool>(m_fallback); }
+
+private:
+  friend class RegexSet;
+
+  std::shared_ptr<const RegexProgram> m_program;
+  std::shared_ptr<const std::regex> m_fallback;
+};
+
+// Combines multiple regular expressions to a single program, so all of them
+// can be searched in a single pass.
+class RegexSet {
+public:
+  int add(const Regex& regex);
+  bool empty() const { return !m_count; }
+
+  // sets matched[i] when regex i matches somewhere in text
+  void search(std::string_view text, std::vector<char>* matched) const;
+
+private:
+  int m_count{ };
+  RegexProgram m_program;
+  std::vector<int> m_program_indices;
+  std::vector<std::pair<int, std::shared_ptr<const std::regex>>> m_fallbacks;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <iterator>
 #include <string>
+#include <string_view>
 
 template<typename ForwardIt>
 bool skip(ForwardIt* it, ForwardIt end, const char* str) {
@@ -88,6 +90,14 @@ void skip_ident(ForwardIt* it, ForwardIt end) {
     ++(*it);
 }
 
+template<typename ContiguousIt>
+std::string_view to_string_view(ContiguousIt begin, ContiguousIt end) {
+  if (begin == end)
+    return { };
+  return std::string_view(&*begin,
+    static_cast<size_t>(std::distance(begin, end)));
+}
+
 template<typename ForwardIt>
 std::string read_value(ForwardIt* it, ForwardIt end) {
   const auto begin = *it;
@@ -0,0 +1,83 @@
+
+#include "ActionQueue.h"
+#include "ChildProcesses.h"
+#include "config/Config.h"
+#include "../common.h"
+#include <algorithm>
+
+namespace {
+  // pending actions are coalesced, so this is only reached when
+  // a lot of different actions are triggered at once
+  const auto max_pending = 32;
+} // namespace
+
+ActionQueue::ActionQueue(const std::vector<Action>& actions, int max_running)
+  : m_actions(actions),
+    m_max_running(max_running),
+    m_running(actions.size()) {
+}
+
+void ActionQueue::push(int action, Clock::time_point triggered) {
+  if (action < 0 || action >= static_cast<int>(m_actions.size()))
+    return;
+
+  // without a limit every trigger is started
+  if (m_max_running <= 0) {
+    m_pending.push_back({ action, triggered });
+    return;
+  }
+
+  // an action which is still pending is not queued again
+  if (std::any_of(m_pending.begin(), m_pending.end(),
+        [&](const Pending& pending) { return pending.action == action; })) {
+    ++m_coalesced;
+    verbose("Coalesced pending action #%i (%i coalesced in total)",
+      action + 1, m_coalesced);
+    return;
+  }
+  if (m_pending.size() >= max_pending) {
+    ++m_dropped;
+    error("Dropped action #%i, too many are pending (%i dropped in total)",
+      action + 1, m_dropped);
+    return;
+  }
+  m_pending.push_back({ action, triggered });
+}
+
+void ActionQueue::start(ChildProcesses& children) {
+  // start pending actions in order, unless too many instances are running
+  auto it = m_pending.begin();
+  while (it != m_pending.end()) {
+    const auto [action, triggered] = *it;
+    if (m_max_running > 0 && m_running[action] >= m_max_running) {
+      ++it;
+      continue;
+    }
+    it = m_pending.erase(it);
+
+    const auto& command = m_actions[action].terminal_command;
+    // the parent is suspended until the child called exec
+    const auto pid = children.spawn_terminal_command(command);
+    if (pid < 0) {
+      error("Executing terminal command '%s' failed", command.c_str());
+      continue;
+    }
+    const auto latency = std::chrono::duration_cast<
+      std::chrono::microseconds>(Clock::now() - triggered);
+    verbose("Executed terminal command '%s' after %i us (%i running)",
+      command.c_str(), static_cast<int>(latency.count()),
+      children.outstanding());
+    ++m_running[action];
+    m_processes.emplace_back(pid, action);
+  }
+}
+
+void ActionQueue::finished(pid_t pid) {
+  // processes of a previous configuration are unknown
+  const auto it = std::find_if(m_processes.begin(), m_processes.end(),
+    [&](const auto& process) { return process.first == pid; });
+  if (it != m_processes.end()) {
+    --m_running[it->second];
+    m_processes.erase(it);
+  }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <sys/types.h>
+
+struct Action;
+class ChildProcesses;
+
+// Queues triggered actions, so they can be started when no more than
+// a limited number of instances of the same action are still running.
+// The limit applies to each action, but is the same for all of them.
+// Repeated triggers of an action which can not be started yet are
+// combined.
+class ActionQueue {
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Pending {
+    int action;
+    Clock::time_point triggered;
+  };
+
+public:
+  ActionQueue(const std::vector<Action>& actions, int max_running);
+
+  void push(int action, Clock::time_point triggered);
+  void start(ChildProcesses& children);
+  void finished(pid_t pid);
+  bool empty() const { return m_pending.empty(); }
+  int coalesced() const { return m_coalesced; }
+  int dropped() const { return m_dropped; }
+
+private:
+  const std::vector<Action>& m_actions;
+  const int m_max_running;
+  std::vector<Pending> m_pending;
+  std::vector<int> m_running;
+  std::vector<std::pair<pid_t, int>> m_processes;
+  int m_coalesced{ };
+  int m_dropped{ };
+};
@@ -0,0 +1,175 @@
+
+#include "AnalyzeConfig.h"
+#include "config/CreateStage.h"
+#include "config/FindHeldBackSequences.h"
+#include "config/Key.h"
+#include "../common.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <utility>
+
+namespace {
+  struct Event {
+    double time_ms;
+    KeyEvent event;
+  };
+
+  // a command which was only defined in contexts forwards its input
+  // in all others
+  bool has_default_mapping(const Command& command) {
+    return (command.default_mapping != KeySequence{
+      { any_key, KeyState::Down } });
+  }
+
+  std::string format_command(const Command& command) {
+    // generated names of direct mappings start with '#'
+    auto string = (!command.name.empty() && command.name.front() != '#' ?
+      command.name : "'" + format_key_sequence(command.input) + "'");
+
+    // list the contexts which map it, numbered like in keymapper-replay
+    if (!command.context_mappings.empty()) {
+      string += (has_default_mapping(command) ?
+        " (overridden in context" : " (only mapped in context");
+      if (command.context_mappings.size() > 1)
+        string += 's';
+      auto first = true;
+      for (const auto& context_mapping : command.context_mappings) {
+        string += (std::exchange(first, false) ? " " : ", ");
+        string += std::to_string(context_mapping.context_index + 1);
+      }
+      string += ')';
+    }
+    return string;
+  }
+
+  void analyze_prefixes(const Config& config, const Stage& stage) {
+    // sorted by sequence
+    auto held_back = std::map<std::string, int>();
+    for (const auto& [sequence, index] : find_held_back_sequences(stage))
+      held_back.emplace(format_key_sequence(sequence), index);
+
+    std::printf("Sequences which are held back in all contexts:\n");
+    if (held_back.empty())
+      std::printf("  none\n");
+    for (const auto& [sequence, index] : held_back)
+      std::printf("  %-30s by %s\n", sequence.c_str(),
+        format_command(config.commands[static_cast<size_t>(index)]).c_str());
+  }
+
+  bool read_corpus(const std::string& filename, std::vector<Event>* events) {
+    auto file = std::ifstream(filename);
+    if (!file.good()) {
+      error("Opening corpus '%s' failed", filename.c_str());
+      return false;
+    }
+
+    auto line_no = 0;
+    auto line = std::string();
+    while (std::getline(file, line)) {
+      ++line_no;
+      auto stream = std::istringstream(line);
+      auto time_ms = 0.0;
+      auto key_event = std::string();
+      if (!(stream >> time_ms)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos ||
+            line[line.find_first_not_of(" \t\r")] == '#')
+          continue;
+      }
+      else if (stream >> key_event && key_event.size() > 1 &&
+               (key_event[0] == '+' || key_event[0] == '-')) {
+        const auto key = get_key_by_name(
+          std::string_view(key_event).substr(1));
+        if (key != Key::None && *key < any_key) {
+          events->push_back({ time_ms, KeyEvent(*key,
+            key_event[0] == '+' ? KeyState::Down : KeyState::Up) });
+          continue;
+        }
+      }
+      error("Invalid event in line %i of corpus", line_no);
+      return false;
+    }
+    return true;
+  }
+
+  void replay_corpus(const Config& config, Stage& stage,
+      const std::vector<Event>& events) {
+    struct Cause {
+      int count;
+      int events;
+      double total_ms;
+    };
+    auto causes = std::map<int, Cause>();
+    auto durations = std::vector<double>();
+    auto held_back_events = 0;
+    auto hold_start = 0.0;
+    auto hold_cause = -1;
+
+    for (const auto& [time_ms, event] : events) {
+      const auto was_held_back = stage.is_sequence_held_back();
+      stage.apply_input(event);
+
+      if (was_held_back && !stage.is_sequence_held_back()) {
+        durations.push_back(time_ms - hold_start);
+        causes[hold_cause].total_ms += durations.back();
+      }
+      if (stage.is_sequence_held_back()) {
+        if (!was_held_back) {
+          auto result = MatchResult{ };
+          hold_start = time_ms;
+          hold_cause = find_first_match(stage, stage.sequence(), &result);
+          ++causes[hold_cause].count;
+        }
+        ++held_back_events;
+        ++causes[hold_cause].events;
+      }
+    }
+
+    std::printf("Replayed %zu events, %i held back (%.1f%%), %zu times:\n",
+      events.size(), held_back_events, (events.empty() ? 0.0 :
+        100.0 * held_back_events / static_cast<double>(events.size())),
+      durations.size());
+    if (!durations.empty()) {
+      std::sort(durations.begin(), durations.end());
+      auto total = 0.0;
+      for (auto duration : durations)
+        total += duration;
+      std::printf("  delay mean %.1f ms, median %.1f ms, "
+        "95th percentile %.1f ms, max %.1f ms\n",
+        total / static_cast<double>(durations.size()),
+        durations[durations.size() / 2],
+        durations[durations.size() * 95 / 100],
+        durations.back());
+    }
+
+    // most delaying mappings first
+    auto sorted = std::vector<std::pair<int, Cause>>(
+      causes.begin(), causes.end());
+    std::sort(sorted.begin(), sorted.end(),
+      [](const auto& a, const auto& b) {
+        return a.second.total_ms > b.second.total_ms;
+      });
+    for (const auto& [index, cause] : sorted)
+      std::printf("  %5i times, %6i events, %9.1f ms by %s\n",
+        cause.count, cause.events, cause.total_ms, (index < 0 ? "none" :
+          format_command(config.commands[static_cast<size_t>(index)]).c_str()));
+  }
+} // namespace
+
+bool analyze_config(const Config& config, const std::string& corpus_file_path) {
+  const auto stage = create_stage(config);
+  analyze_prefixes(config, *stage);
+
+  if (corpus_file_path.empty())
+    return true;
+
+  auto events = std::vector<Event>();
+  if (!read_corpus(corpus_file_path, &events))
+    return false;
+
+  std::printf("\n");
+  replay_corpus(config, *stage, events);
+  return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+struct Config;
+
+// Reports which key sequences are held back, because a mapping might match
+// when more keys follow. When a corpus file is passed, it is replayed and
+// the held back events and their delays are reported.
+// The corpus contains one event per line, prefixed with a time in ms:
+//   120 +ShiftLeft
+//   180 +A
+bool analyze_config(const Config& config, const std::string& corpus_file_path);
@@ -0,0 +1,78 @@
+
+#include "ChildProcesses.h"
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+ChildProcesses::~ChildProcesses() {
+  if (m_signal_fd >= 0)
+    ::close(m_signal_fd);
+  if (m_initialized) {
+    posix_spawn_file_actions_destroy(&m_file_actions);
+    posix_spawnattr_destroy(&m_attributes);
+  }
+}
+
+bool ChildProcesses::initialize(bool forward_output) {
+  // SIGCHLD is only received through the signal fd
+  auto signals = sigset_t{ };
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGCHLD);
+  if (::sigprocmask(SIG_BLOCK, &signals, nullptr) != 0)
+    return false;
+  m_signal_fd = ::signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (m_signal_fd < 0)
+    return false;
+
+  // the descriptors are only opened in the child
+  posix_spawn_file_actions_init(&m_file_actions);
+  posix_spawnattr_init(&m_attributes);
+  m_initialized = true;
+  posix_spawn_file_actions_addopen(&m_file_actions,
+    STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  if (!forward_output) {
+    posix_spawn_file_actions_addopen(&m_file_actions,
+      STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_adddup2(&m_file_actions,
+      STDOUT_FILENO, STDERR_FILENO);
+  }
+
+  // do not let the children inherit the blocked SIGCHLD
+  auto no_signals = sigset_t{ };
+  sigemptyset(&no_signals);
+  posix_spawnattr_setsigmask(&m_attributes, &no_signals);
+  posix_spawnattr_setflags(&m_attributes, POSIX_SPAWN_SETSIGMASK);
+  return true;
+}
+
+pid_t ChildProcesses::spawn_terminal_command(const std::string& command) {
+  char sh[] = "sh";
+  char c[] = "-c";
+  char* const argv[] = { sh, c, const_cast<char*>(command.c_str()), nullptr };
+  auto pid = pid_t{ };
+  if (::posix_spawn(&pid, "/bin/sh", &m_file_actions,
+        &m_attributes, argv, environ) != 0)
+    return -1;
+  ++m_outstanding;
+  return pid;
+}
+
+bool ChildProcesses::reap(pid_t* pid) {
+  // signals are coalesced, so drain the fd and then reap all exited children
+  auto info = signalfd_siginfo{ };
+  while (::read(m_signal_fd, &info, sizeof(info)) == sizeof(info))
+    continue;
+
+  if (!m_outstanding)
+    return false;
+  auto status = 0;
+  *pid = ::waitpid(-1, &status, WNOHANG);
+  if (*pid <= 0)
+    return false;
+  --m_outstanding;
+  return true;
+}
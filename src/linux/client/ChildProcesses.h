@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+#include <spawn.h>
+
+// Spawns terminal commands without duplicating the client's address space
+// and reaps the exited children without blocking.
+class ChildProcesses {
+public:
+  ChildProcesses() = default;
+  ChildProcesses(const ChildProcesses&) = delete;
+  ChildProcesses& operator=(const ChildProcesses&) = delete;
+  ~ChildProcesses();
+
+  bool initialize(bool forward_output);
+  int signal_fd() const { return m_signal_fd; }
+  int outstanding() const { return m_outstanding; }
+
+  // returns the process id or -1 on failure
+  pid_t spawn_terminal_command(const std::string& command);
+
+  // returns false when no further child exited
+  bool reap(pid_t* pid);
+
+private:
+  bool m_initialized{ };
+  posix_spawn_file_actions_t m_file_actions;
+  posix_spawnattr_t m_attributes;
+  int m_signal_fd{ -1 };
+  int m_outstanding{ };
+};
@@ -2,19 +2,62 @@
 #include "ConfigFile.h"
 #include "config/ParseConfig.h"
 #include "../common.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
 #include <cstdio>
-#include <fstream>
+#include <cstdlib>
+#include <functional>
+#include <string_view>
+#include <fcntl.h>
 #include <unistd.h>
 #include <pwd.h>
-#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
 
-std::time_t get_modify_time(const std::string& filename) {
-  using stat_t = struct stat;
-  auto st = stat_t{ };
-  if (::stat(filename.c_str(), &st) == 0)
-    return st.st_mtime;
-  return { };
-}
+namespace {
+  // the file is reloaded when it was not touched for this interval
+  const auto debounce_interval_ms = 50;
+
+  // editors either write the file or replace it with a renamed one
+  const auto monitor_events =
+    IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+
+  std::pair<std::string, std::string> split_path(const std::string& filename) {
+    const auto slash = filename.rfind('/');
+    if (slash == std::string::npos)
+      return { ".", filename };
+    return { filename.substr(0, std::max(slash, size_t{ 1 })),
+             filename.substr(slash + 1) };
+  }
+
+  // reads the file into a buffer, which is reused between reloads
+  bool read_file(const std::string& filename, std::string* buffer) {
+    const auto fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return false;
+    buffer->clear();
+    auto succeeded = true;
+    for (;;) {
+      const auto size = buffer->size();
+      buffer->resize(std::max(size + 4096, buffer->capacity()));
+      const auto result = ::read(fd, buffer->data() + size,
+        buffer->size() - size);
+      if (result < 0 && errno == EINTR) {
+        buffer->resize(size);
+        continue;
+      }
+      buffer->resize(size + static_cast<size_t>(std::max(result, ssize_t{ })));
+      if (result <= 0) {
+        succeeded = (result == 0);
+        break;
+      }
+    }
+    ::close(fd);
+    return succeeded;
+  }
+} // namespace
 
 std::string get_home_directory() {
   if (auto homedir = ::getenv("HOME"))
@@ -26,22 +69,139 @@ ConfigFile::ConfigFile(std::string filename)
   : m_filename(std::move(filename)) {
 }
 
-bool ConfigFile::update() {
-  const auto modify_time = get_modify_time(m_filename);
-  if (modify_time == m_modify_time)
+ConfigFile::~ConfigFile() {
+  release_monitor();
+}
+
+void ConfigFile::release_monitor() {
+  for (auto fd : { m_monitor_fd, m_inotify_fd, m_timer_fd })
+    if (fd >= 0)
+      ::close(fd);
+  m_monitor_fd = m_inotify_fd = m_timer_fd = -1;
+  m_watches.clear();
+}
+
+bool ConfigFile::initialize_monitor() {
+  // combine inotify and debounce timer to a single fd
+  m_monitor_fd = ::epoll_create1(EPOLL_CLOEXEC);
+  m_inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  m_timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (m_monitor_fd < 0 || m_inotify_fd < 0 || m_timer_fd < 0) {
+    release_monitor();
     return false;
-  m_modify_time = modify_time;
+  }
+  for (auto fd : { m_inotify_fd, m_timer_fd }) {
+    auto event = epoll_event{ };
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    ::epoll_ctl(m_monitor_fd, EPOLL_CTL_ADD, fd, &event);
+  }
 
-  auto is = std::ifstream(m_filename);
-  if (is.good()) {
-    try {
-      auto parse = ParseConfig();
-      m_config = parse(is);
+  // watch containing directories of file and of symlink's target
+  auto succeeded = add_watch(m_filename);
+  char real_path[PATH_MAX];
+  if (::realpath(m_filename.c_str(), real_path) &&
+      m_filename != real_path)
+    succeeded |= add_watch(real_path);
+
+  if (!succeeded) {
+    release_monitor();
+    return false;
+  }
+  add_watches_for_included_files();
+  return true;
+}
+
+bool ConfigFile::add_watch(const std::string& filename) {
+  auto [directory, name] = split_path(filename);
+  const auto wd = ::inotify_add_watch(m_inotify_fd,
+    directory.c_str(), monitor_events);
+  if (wd < 0)
+    return false;
+  for (const auto& watch : m_watches)
+    if (watch.wd == wd && watch.name == name)
+      return true;
+  m_watches.push_back({ wd, std::move(name) });
+  return true;
+}
+
+void ConfigFile::add_watches_for_included_files() {
+  if (m_inotify_fd < 0)
+    return;
+  for (const auto& file : m_included_files)
+    if (!add_watch(file.filename))
+      error("Monitoring '%s' failed", file.filename.c_str());
+}
+
+bool ConfigFile::included_files_changed() {
+  for (const auto& file : m_included_files)
+    if (!read_file(file.filename, &m_include_buffer) ||
+        std::hash<std::string_view>()(m_include_buffer) != file.content_hash)
+      return true;
+  return false;
+}
+
+bool ConfigFile::read_monitor_events() {
+  alignas(inotify_event) char buffer[4096];
+  auto touched = false;
+  for (;;) {
+    const auto length = ::read(m_inotify_fd, buffer, sizeof(buffer));
+    if (length <= 0)
+      break;
+    for (auto offset = 0l; offset < length; ) {
+      const auto& event = *reinterpret_cast<const inotify_event*>(&buffer[offset]);
+      offset += static_cast<long>(sizeof(inotify_event) + event.len);
+      if (event.len)
+        for (const auto& watch : m_watches)
+          if (event.wd == watch.wd && watch.name == event.name)
+            touched = true;
     }
-    catch (const std::exception& ex) {
-      error("%s", ex.what());
+  }
+
+  // restart timer on each touch
+  if (touched) {
+    auto timeout = itimerspec{ };
+    timeout.it_value.tv_sec = debounce_interval_ms / 1000;
+    timeout.it_value.tv_nsec = (debounce_interval_ms % 1000) * 1000000l;
+    ::timerfd_settime(m_timer_fd, 0, &timeout, nullptr);
+  }
+  return touched;
+}
+
+bool ConfigFile::read_timer_expired() {
+  auto expirations = uint64_t{ };
+  return (::read(m_timer_fd, &expirations, sizeof(expirations)) ==
+    sizeof(expirations));
+}
+
+bool ConfigFile::update() {
+  // when monitored, only check file after it was not touched for a while
+  if (m_monitor_fd >= 0) {
+    read_monitor_events();
+    if (!read_timer_expired())
       return false;
-    }
   }
-  return true;
+
+  // only parse when the contents of the file or included files changed
+  if (!read_file(m_filename, &m_buffer))
+    return false;
+  const auto contents = std::string_view(m_buffer);
+  const auto content_hash = std::hash<std::string_view>()(contents);
+  if (content_hash == m_content_hash && !included_files_changed())
+    return false;
+
+  // the parser keeps a cache of unchanged included files
+  auto succeeded = true;
+  try {
+    m_config = m_parse_config(contents, true, m_filename);
+    m_content_hash = content_hash;
+  }
+  catch (const std::exception& ex) {
+    error("%s", ex.what());
+    m_content_hash = { };
+    succeeded = false;
+  }
+  m_included_files = m_parse_config.included_files();
+  add_watches_for_included_files();
+  return succeeded;
 }
@@ -1,19 +1,44 @@
 #pragma once
 
-#include "config/Config.h"
-#include <ctime>
+#include "config/ParseConfig.h"
 #include <string>
+#include <vector>
 
 class ConfigFile {
 public:
   explicit ConfigFile(std::string filename);
+  ConfigFile(const ConfigFile&) = delete;
+  ConfigFile& operator=(const ConfigFile&) = delete;
+  ~ConfigFile();
 
+  bool initialize_monitor();
+  int monitor_fd() const { return m_monitor_fd; }
   bool update();
   const Config& config() const { return m_config; }
 
 private:
+  struct Watch {
+    int wd;
+    std::string name;
+  };
+
+  void release_monitor();
+  bool add_watch(const std::string& filename);
+  void add_watches_for_included_files();
+  bool included_files_changed();
+  bool read_monitor_events();
+  bool read_timer_expired();
+
   const std::string m_filename;
-  std::time_t m_modify_time{ };
+  size_t m_content_hash{ };
+  int m_monitor_fd{ -1 };
+  int m_inotify_fd{ -1 };
+  int m_timer_fd{ -1 };
+  std::vector<Watch> m_watches;
+  std::string m_buffer;
+  std::string m_include_buffer;
+  ParseConfig m_parse_config;
+  std::vector<ParseConfig::File> m_included_files;
   Config m_config;
 };
 
@@ -1,15 +1,25 @@
 
 #include "FocusedWindow.h"
 
-#if defined(ENABLE_X11)
+#if defined(ENABLE_XCB)
+
+// implemented in FocusedWindowXCB.cpp
+
+#elif defined(ENABLE_X11)
 
 # include <X11/X.h>
 # include <X11/Xlib.h>
 # include <X11/Xatom.h>
 # include <X11/Xutil.h>
 # include <X11/Xos.h>
+# include <chrono>
+# include <utility>
+# include "../common.h"
 
 class FocusedWindow {
+private:
+  using Clock = std::chrono::steady_clock;
+
 public:
   ~FocusedWindow() {
     if (m_display)
@@ -29,18 +39,95 @@ public:
     m_net_wm_name_atom = XInternAtom(m_display, "_NET_WM_NAME", False);
     m_utf8_string_atom = XInternAtom(m_display, "UTF8_STRING", False);
     XSetErrorHandler([](Display*, XErrorEvent*) { return 0; });
+
+    // get notified when the active window changes
+    XSelectInput(m_display, m_root_window, PropertyChangeMask);
+    m_event_time = Clock::now();
     return true;
   }
 
+  int event_fd() const {
+    return ConnectionNumber(m_display);
+  }
+
   bool update() {
-    const auto window = get_focused_window();
+    // only query window properties after they were changed,
+    // querying can read further events into the queue
+    auto changed = false;
+    while (read_property_events())
+      changed |= update_focused_window();
+
+    if (changed) {
+      const auto latency = std::chrono::duration_cast<
+        std::chrono::microseconds>(Clock::now() - m_event_time);
+      verbose("Focused window update took %i round-trips (%i in total), %i us",
+        m_round_trips - m_round_trips_reported, m_round_trips,
+        static_cast<int>(latency.count()));
+      m_round_trips_reported = m_round_trips;
+    }
+    m_event_time = { };
+    return changed;
+  }
+
+private:
+  bool read_property_events() {
+    while (XPending(m_display) > 0) {
+      auto event = XEvent{ };
+      XNextEvent(m_display, &event);
+      if (event.type != PropertyNotify)
+        continue;
+
+      // ignore changes of properties which are not of interest
+      const auto& property = event.xproperty;
+      if (property.window == m_root_window &&
+          property.atom == m_net_active_window_atom) {
+        m_active_window_changed = true;
+      }
+      else if (property.window == m_observed_window &&
+               property.atom == m_net_wm_name_atom) {
+        m_window_title_changed = true;
+      }
+      else {
+        continue;
+      }
+      if (m_event_time == Clock::time_point{ })
+        m_event_time = Clock::now();
+    }
+    return (m_active_window_changed || m_window_title_changed);
+  }
+
+  void observe_window(Window window) {
+    if (window == m_observed_window)
+      return;
+
+    // get notified when the title of the focused window changes
+    if (m_observed_window)
+      XSelectInput(m_display, m_observed_window, NoEventMask);
+    if (window)
+      XSelectInput(m_display, window, PropertyChangeMask);
+    m_observed_window = window;
+  }
+
+  bool update_focused_window() {
+    if (std::exchange(m_active_window_changed, false)) {
+      const auto window = get_focused_window();
+      if (window != m_observed_window) {
+        observe_window(window);
+        m_window_title_changed = true;
+      }
+    }
+    if (!std::exchange(m_window_title_changed, false))
+      return false;
+
+    const auto window = m_observed_window;
     auto window_title = get_window_title(window);
     if (window == m_focused_window &&
         window_title == m_focused_window_title)
       return false;
 
     // window handles can become invalid any time
-    auto window_class = get_window_class(window);
+    auto window_class = (window == m_focused_window ?
+      m_focused_window_class : get_window_class(window));
     if (window_class.empty() || window_title.empty())
       return false;
 
@@ -50,13 +137,13 @@ public:
     return true;
   }
 
-private:
   Window get_focused_window() {
     auto type = Atom{ };
     auto format = 0;
     auto length = 0ul;
     auto rest = 0ul;
     auto data = std::add_pointer_t<unsigned char>{ };
+    ++m_round_trips;
     if (XGetWindowProperty(m_display, m_root_window, m_net_active_window_atom,
           0L, sizeof(Window), False, XA_WINDOW, &type, &format,
           &length, &rest, &data) == Success &&
@@ -69,9 +156,12 @@ private:
   }
 
   std::string get_window_class(Window window) {
+    if (!window)
+      return { };
+
+    ++m_round_trips;
     auto ch = XClassHint{ };
-    if (window &&
-        XGetClassHint(m_display, window, &ch) != 0) {
+    if (XGetClassHint(m_display, window, &ch) != 0) {
       auto result = std::string(ch.res_name);
       XFree(ch.res_name);
       XFree(ch.res_class);
@@ -86,8 +176,11 @@ private:
     auto length = 0ul;
     auto rest = 0ul;
     auto data = std::add_pointer_t<unsigned char>{ };
-    if (window &&
-        XGetWindowProperty(m_display, window, m_net_wm_name_atom, 0, 1024,
+    if (!window)
+      return { };
+
+    ++m_round_trips;
+    if (XGetWindowProperty(m_display, window, m_net_wm_name_atom, 0, 1024,
           False, m_utf8_string_atom, &type, &format, &length,
           &rest, &data) == Success &&
         data) {
@@ -103,6 +196,12 @@ private:
   Atom m_net_active_window_atom{ };
   Atom m_net_wm_name_atom{ };
   Atom m_utf8_string_atom{ };
+  bool m_active_window_changed{ true };
+  bool m_window_title_changed{ };
+  Clock::time_point m_event_time{ };
+  int m_round_trips{ };
+  int m_round_trips_reported{ };
+  Window m_observed_window{ };
   Window m_focused_window{ };
   std::string m_focused_window_class;
   std::string m_focused_window_title;
@@ -123,6 +222,10 @@ bool update_focused_window(FocusedWindow& window) {
   return window.update();
 }
 
+int get_event_fd(const FocusedWindow& window) {
+  return window.event_fd();
+}
+
 const std::string& get_class(const FocusedWindow& window) {
   return window.get_class();
 }
@@ -144,6 +247,10 @@ bool update_focused_window(FocusedWindow&) {
   return false;
 }
 
+int get_event_fd(const FocusedWindow&) {
+  return -1;
+}
+
 const std::string& get_class(const FocusedWindow&) {
   static std::string empty;
   return empty;
@@ -9,5 +9,6 @@ using FocusedWindowPtr = std::unique_ptr<FocusedWindow, FreeFocusedWindow>;
 
 FocusedWindowPtr create_focused_window();
 bool update_focused_window(FocusedWindow& window);
+int get_event_fd(const FocusedWindow& window);
 const std::string& get_class(const FocusedWindow& window);
 const std::string& get_title(const FocusedWindow& window);
@@ -0,0 +1,323 @@
+
+#include "FocusedWindow.h"
+
+#if defined(ENABLE_XCB)
+
+# include <xcb/xcb.h>
+# include <xcb/xcbext.h>
+# include <chrono>
+# include <cstdlib>
+# include <cstring>
+# include <optional>
+# include <utility>
+# include "../common.h"
+
+// Queries are sent asynchronously and their replies are collected, when the
+// connection becomes readable. So a slow X server never blocks the client.
+class FocusedWindow {
+private:
+  using Clock = std::chrono::steady_clock;
+  using Request = std::optional<xcb_get_property_cookie_t>;
+
+public:
+  ~FocusedWindow() {
+    if (m_connection)
+      xcb_disconnect(m_connection);
+  }
+
+  const std::string& get_class() const { return m_focused_window_class; }
+  const std::string& get_title() const { return m_focused_window_title; }
+
+  bool initialize() {
+    auto screen_number = 0;
+    m_connection = xcb_connect(nullptr, &screen_number);
+    if (xcb_connection_has_error(m_connection))
+      return false;
+
+    auto screen = xcb_setup_roots_iterator(xcb_get_setup(m_connection));
+    for (; screen.rem && screen_number > 0; --screen_number)
+      xcb_screen_next(&screen);
+    if (!screen.rem)
+      return false;
+    m_root_window = screen.data->root;
+
+    // send all requests before waiting for the replies
+    const auto net_active_window = intern_atom("_NET_ACTIVE_WINDOW");
+    const auto net_wm_name = intern_atom("_NET_WM_NAME");
+    const auto utf8_string = intern_atom("UTF8_STRING");
+    m_net_active_window_atom = get_atom(net_active_window);
+    m_net_wm_name_atom = get_atom(net_wm_name);
+    m_utf8_string_atom = get_atom(utf8_string);
+    if (!m_net_active_window_atom || !m_net_wm_name_atom)
+      return false;
+
+    // get notified when the active window changes
+    select_property_events(m_root_window, true);
+    xcb_flush(m_connection);
+    m_event_time = Clock::now();
+    return true;
+  }
+
+  int event_fd() const {
+    if (xcb_connection_has_error(m_connection))
+      return -1;
+    return xcb_get_file_descriptor(m_connection);
+  }
+
+  bool update() {
+    if (xcb_connection_has_error(m_connection))
+      return false;
+
+    // reading events can also read replies and vice versa,
+    // so continue until neither makes progress
+    auto changed = false;
+    do {
+      read_property_events(xcb_poll_for_event);
+      send_requests();
+    } while (receive_replies(&changed));
+
+    // polling for a reply can read events into the queue, then the
+    // connection would not become readable again
+    if (read_property_events(xcb_poll_for_queued_event))
+      send_requests();
+    xcb_flush(m_connection);
+
+    if (changed) {
+      const auto latency = std::chrono::duration_cast<
+        std::chrono::microseconds>(Clock::now() - m_event_time);
+      verbose("Focused window update took %i requests (%i in total), %i us",
+        m_requests - m_requests_reported, m_requests,
+        static_cast<int>(latency.count()));
+      m_requests_reported = m_requests;
+    }
+    if (!has_pending_requests())
+      m_event_time = { };
+    return changed;
+  }
+
+private:
+  xcb_intern_atom_cookie_t intern_atom(const char* name) {
+    return xcb_intern_atom(m_connection, 0,
+      static_cast<uint16_t>(std::strlen(name)), name);
+  }
+
+  xcb_atom_t get_atom(xcb_intern_atom_cookie_t cookie) {
+    auto atom = xcb_atom_t{ XCB_ATOM_NONE };
+    if (auto reply = xcb_intern_atom_reply(m_connection, cookie, nullptr)) {
+      atom = reply->atom;
+      std::free(reply);
+    }
+    return atom;
+  }
+
+  void select_property_events(xcb_window_t window, bool select) {
+    const uint32_t event_mask = (select ?
+      XCB_EVENT_MASK_PROPERTY_CHANGE : XCB_EVENT_MASK_NO_EVENT);
+    xcb_change_window_attributes(m_connection, window,
+      XCB_CW_EVENT_MASK, &event_mask);
+  }
+
+  bool read_property_events(
+      xcb_generic_event_t* (*poll_for_event)(xcb_connection_t*)) {
+    auto received = false;
+    while (auto event = poll_for_event(m_connection)) {
+      received = true;
+      if ((event->response_type & ~0x80) == XCB_PROPERTY_NOTIFY) {
+        // ignore changes of properties which are not of interest
+        const auto& property =
+          *reinterpret_cast<const xcb_property_notify_event_t*>(event);
+        if (property.window == m_root_window &&
+            property.atom == m_net_active_window_atom) {
+          m_active_window_changed = true;
+        }
+        else if (property.window == m_observed_window &&
+                 property.atom == m_net_wm_name_atom) {
+          m_window_title_changed = true;
+        }
+        if (m_event_time == Clock::time_point{ } &&
+            (m_active_window_changed || m_window_title_changed))
+          m_event_time = Clock::now();
+      }
+      std::free(event);
+    }
+    return received;
+  }
+
+  void observe_window(xcb_window_t window) {
+    if (window == m_observed_window)
+      return;
+
+    // get notified when the title of the focused window changes
+    if (m_observed_window)
+      select_property_events(m_observed_window, false);
+    if (window)
+      select_property_events(window, true);
+    m_observed_window = window;
+  }
+
+  xcb_get_property_cookie_t get_property(xcb_window_t window,
+      xcb_atom_t property, xcb_atom_t type, uint32_t length) {
+    ++m_requests;
+    return xcb_get_property(m_connection, 0, window,
+      property, type, 0, length);
+  }
+
+  bool has_pending_requests() const {
+    return (m_active_window_request ||
+      m_window_title_request || m_window_class_request);
+  }
+
+  void send_requests() {
+    if (m_active_window_changed && !m_active_window_request) {
+      m_active_window_changed = false;
+      m_active_window_request = get_property(m_root_window,
+        m_net_active_window_atom, XCB_ATOM_WINDOW, 1);
+    }
+
+    // the window is only known after the active window request finished,
+    // class and title requests for it are pipelined
+    if (m_window_title_changed && m_observed_window &&
+        !has_pending_requests()) {
+      m_window_title_changed = false;
+      m_requested_window = m_observed_window;
+      m_window_title_request = get_property(m_requested_window,
+        m_net_wm_name_atom, m_utf8_string_atom, 1024);
+      if (m_requested_window != m_focused_window)
+        m_window_class_request = get_property(m_requested_window,
+          XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 1024);
+    }
+  }
+
+  // returns false when reply did not arrive yet
+  bool poll_for_reply(Request& request, std::string* value) {
+    auto reply = std::add_pointer_t<void>{ };
+    auto error = std::add_pointer_t<xcb_generic_error_t>{ };
+    if (!xcb_poll_for_reply(m_connection, request->sequence, &reply, &error))
+      return false;
+
+    // window handles can become invalid any time
+    value->clear();
+    if (reply) {
+      const auto property = static_cast<xcb_get_property_reply_t*>(reply);
+      const auto data = static_cast<const char*>(
+        xcb_get_property_value(property));
+      const auto length = xcb_get_property_value_length(property);
+      value->assign(data, data + length);
+    }
+    std::free(reply);
+    std::free(error);
+    request.reset();
+    return true;
+  }
+
+  Request* get_first_pending_request() {
+    auto first = std::add_pointer_t<Request>{ };
+    for (auto request : { &m_active_window_request,
+                          &m_window_title_request,
+                          &m_window_class_request })
+      if (*request && (!first || static_cast<int>(
+            (*request)->sequence - (*first)->sequence) < 0))
+        first = request;
+    return first;
+  }
+
+  bool receive_replies(bool* changed) {
+    // replies arrive in the order of the requests, so by stopping at the
+    // first one which did not arrive yet, none is left in the queue
+    auto received = false;
+    auto value = std::string();
+    while (auto request = get_first_pending_request()) {
+      if (!poll_for_reply(*request, &value))
+        break;
+      received = true;
+
+      if (request == &m_active_window_request) {
+        auto window = xcb_window_t{ };
+        if (value.size() == sizeof(window))
+          std::memcpy(&window, value.data(), sizeof(window));
+        if (window != m_observed_window) {
+          observe_window(window);
+          m_window_title_changed = true;
+        }
+      }
+      // only keep first of null-separated strings
+      else if (request == &m_window_title_request) {
+        m_requested_window_title = value.c_str();
+      }
+      else {
+        m_requested_window_class = value.c_str();
+      }
+    }
+
+    if (received && m_requested_window &&
+        !m_window_title_request && !m_window_class_request)
+      *changed |= apply_requested_window();
+    return received;
+  }
+
+  bool apply_requested_window() {
+    const auto window = std::exchange(m_requested_window, xcb_window_t{ });
+    if (window == m_focused_window) {
+      if (m_requested_window_title == m_focused_window_title)
+        return false;
+      m_requested_window_class = m_focused_window_class;
+    }
+    if (m_requested_window_class.empty() || m_requested_window_title.empty())
+      return false;
+
+    m_focused_window = window;
+    std::swap(m_focused_window_class, m_requested_window_class);
+    std::swap(m_focused_window_title, m_requested_window_title);
+    return true;
+  }
+
+  xcb_connection_t* m_connection{ };
+  xcb_window_t m_root_window{ };
+  xcb_atom_t m_net_active_window_atom{ };
+  xcb_atom_t m_net_wm_name_atom{ };
+  xcb_atom_t m_utf8_string_atom{ };
+  bool m_active_window_changed{ true };
+  bool m_window_title_changed{ };
+  Clock::time_point m_event_time{ };
+  int m_requests{ };
+  int m_requests_reported{ };
+  Request m_active_window_request;
+  Request m_window_title_request;
+  Request m_window_class_request;
+  xcb_window_t m_requested_window{ };
+  std::string m_requested_window_class;
+  std::string m_requested_window_title;
+  xcb_window_t m_observed_window{ };
+  xcb_window_t m_focused_window{ };
+  std::string m_focused_window_class;
+  std::string m_focused_window_title;
+};
+
+void FreeFocusedWindow::operator()(FocusedWindow* window) {
+  delete window;
+}
+
+FocusedWindowPtr create_focused_window() {
+  auto window = FocusedWindowPtr(new FocusedWindow());
+  if (!window->initialize())
+    return nullptr;
+  return window;
+}
+
+bool update_focused_window(FocusedWindow& window) {
+  return window.update();
+}
+
+int get_event_fd(const FocusedWindow& window) {
+  return window.event_fd();
+}
+
+const std::string& get_class(const FocusedWindow& window) {
+  return window.get_class();
+}
+
+const std::string& get_title(const FocusedWindow& window) {
+  return window.get_title();
+}
+
+#endif // ENABLE_XCB
@@ -2,6 +2,7 @@
 #include "ServerPort.h"
 #include "config/Config.h"
 #include "../common.h"
+#include <algorithm>
 #include <csignal>
 #include <unistd.h>
 #include <sys/socket.h>
@@ -17,6 +18,13 @@ namespace {
     return succeeded;
   }
 
+  bool send_string(int fd, const std::string& string) {
+    const auto length = static_cast<uint16_t>(
+      std::min(string.size(), size_t{ UINT16_MAX }));
+    return (send(fd, length) &&
+      write_all(fd, string.data(), length));
+  }
+
   bool send_config(int fd, const Config& config) {
     // send mappings
     auto succeeded = send(fd, static_cast<uint16_t>(config.commands.size()));
@@ -43,6 +51,12 @@ namespace {
         succeeded &= send_key_sequence(fd, mapping.second->output);
       }
     }
+
+    // send where mappings were defined
+    for (const auto& command : config.commands) {
+      succeeded &= send(fd, static_cast<uint32_t>(command.line_no));
+      succeeded &= send_string(fd, command.filename);
+    }
     return succeeded;
   }
 } // namespace
@@ -13,6 +13,7 @@ public:
   ~ServerPort();
 
   bool initialize(const char* ipc_filename);
+  int socket_fd() const { return m_socket_fd; }
   bool send_config(const Config& config);
   bool send_active_override_set(int index);
   bool receive_triggered_action(int timeout_ms, int* action);
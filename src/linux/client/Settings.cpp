@@ -1,6 +1,7 @@
 
 #include "Settings.h"
 #include <cstdio>
+#include <cstdlib>
 
 bool interpret_commandline(Settings& settings, int argc, char* argv[]) {
   for (auto i = 1; i < argc; i++) {
@@ -22,6 +23,19 @@ bool interpret_commandline(Settings& settings, int argc, char* argv[]) {
     else if (argument == "--check") {
       settings.check_config = true;
     }
+    else if (argument == "--analyze") {
+      settings.analyze_config = true;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+        settings.corpus_file_path = argv[++i];
+    }
+    else if (argument == "--action-limit") {
+      if (++i >= argc)
+        return false;
+      auto end = std::add_pointer_t<char>{ };
+      settings.max_running_actions = static_cast<int>(std::strtol(argv[i], &end, 10));
+      if (end == argv[i] || *end || settings.max_running_actions < 0)
+        return false;
+    }
     else {
       return false;
     }
@@ -53,6 +67,8 @@ void print_help_message(const char* argv0) {
     "  -v, --verbose        enable verbose output.\n"
     "  --no-color           no color on error output.\n"
     "  --check              check the config for errors.\n"
+    "  --analyze [corpus]   report held back input, replay corpus of events.\n"
+    "  --action-limit <n>   running instances of each action (default 1, 0 = no limit).\n"
     "  -h, --help           print this help.\n"
     "\n"
     "All Rights Reserved.\n"
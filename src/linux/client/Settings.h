@@ -8,6 +8,9 @@ struct Settings {
   bool verbose;
   bool color = true;
   bool check_config;
+  bool analyze_config;
+  std::string corpus_file_path;
+  int max_running_actions = 1;
 };
 
 bool interpret_commandline(Settings& settings, int argc, char* argv[]);
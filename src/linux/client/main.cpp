@@ -3,34 +3,30 @@
 #include "FocusedWindow.h"
 #include "Settings.h"
 #include "ConfigFile.h"
-#include "config/Config.h"
+#include "ChildProcesses.h"
+#include "ActionQueue.h"
+#include "AnalyzeConfig.h"
+#include "config/FindContext.h"
 #include "../common.h"
-#include <csignal>
-#include <unistd.h>
-#include <fcntl.h>
-#include <sys/wait.h>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <poll.h>
 
 namespace {
   const auto ipc_id = "keymapper";
   const auto config_filename = get_home_directory() + "/.config/keymapper.conf";
-  const auto update_interval_ms = 50;
 
-  void catch_child([[maybe_unused]] int sig_num) {
-    auto child_status = 0;
-    ::wait(&child_status);
-  }
+  using Clock = std::chrono::steady_clock;
 
-  void execute_terminal_command(const std::string& command) {
-    verbose("Executing terminal command '%s'", command.c_str());
-    if (fork() == 0) {
-      dup2(open("/dev/null", O_RDONLY), STDIN_FILENO);
-      if (!g_verbose_output) {
-        dup2(open("/dev/null", O_RDWR), STDOUT_FILENO);
-        dup2(open("/dev/null", O_RDWR), STDERR_FILENO);
-      }
-      execl("/bin/sh", "sh", "-c", command.c_str(), nullptr);
-      exit(1);
-    }
+  void wait_until_readable(std::initializer_list<int> fds) {
+    // negative fds are ignored by poll
+    auto pollfds = std::array<pollfd, 4>();
+    auto count = nfds_t{ };
+    for (auto fd : fds)
+      pollfds[count++] = { fd, POLLIN, 0 };
+    while (::poll(pollfds.data(), count, -1) == -1 && errno == EINTR)
+      continue;
   }
 } // namespace
 
@@ -45,7 +41,11 @@ int main(int argc, char* argv[]) {
   g_verbose_output = settings.verbose;
   g_output_color = settings.color;
 
-  ::signal(SIGCHLD, &catch_child);
+  auto children = ChildProcesses();
+  if (!children.initialize(g_verbose_output)) {
+    error("Initializing process spawning failed");
+    return 1;
+  }
 
   // load initial configuration
   verbose("Loading configuration file '%s'", settings.config_file_path.c_str());
@@ -58,6 +58,13 @@ int main(int argc, char* argv[]) {
     printf("The configuration is valid\n");
     return 0;
   }
+  if (settings.analyze_config)
+    return (analyze_config(config_file.config(),
+      settings.corpus_file_path) ? 0 : 1);
+  if (settings.auto_update_config &&
+      !config_file.initialize_monitor())
+    error("Initializing configuration file monitor failed");
+
   for (;;) {
     // initialize client/server IPC
     verbose("Connecting to keymapperd");
@@ -68,6 +75,11 @@ int main(int argc, char* argv[]) {
       return 1;
     }
 
+    // index contexts of configuration
+    auto find_context = FindContext(config_file.config());
+    auto action_queue = ActionQueue(config_file.config().actions,
+      settings.max_running_actions);
+
     // initialize focused window detection
     verbose("Initializing focused window detection");
     auto focused_window = create_focused_window();
@@ -93,7 +105,6 @@ int main(int argc, char* argv[]) {
         verbose("  title = '%s'", get_title(*focused_window).c_str());
 
         const auto override_set = find_context(
-          config_file.config(),
           get_class(*focused_window),
           get_title(*focused_window));
 
@@ -118,17 +129,45 @@ int main(int argc, char* argv[]) {
         }
       }
 
-      // receive triggered actions
-      auto triggered_action = -1;
-      if (!server.receive_triggered_action(update_interval_ms, &triggered_action)) {
+      // start actions after the focused window was updated,
+      // unless too many instances are running
+      action_queue.start(children);
+
+      // sleep until the server, the window system, the file system
+      // or an exiting child process report
+      wait_until_readable({
+        server.socket_fd(),
+        config_file.monitor_fd(),
+        (focused_window ? get_event_fd(*focused_window) : -1),
+        children.signal_fd(),
+      });
+      const auto woken = Clock::now();
+
+      // reap exited child processes
+      auto pid = pid_t{ };
+      while (children.reap(&pid)) {
+        verbose("Terminal command process %i exited (%i running)",
+          static_cast<int>(pid), children.outstanding());
+        action_queue.finished(pid);
+      }
+
+      // queue all triggered actions, they are started after the focused
+      // window was updated
+      auto connected = true;
+      for (;;) {
+        auto triggered_action = -1;
+        if (!server.receive_triggered_action(0, &triggered_action)) {
+          connected = false;
+          break;
+        }
+        if (triggered_action < 0)
+          break;
+        action_queue.push(triggered_action, woken);
+      }
+      if (!connected) {
         verbose("Connection to keymapperd lost");
         break;
       }
-      if (triggered_action >= 0 &&
-          triggered_action < static_cast<int>(config_file.config().actions.size())) {
-        const auto& action = config_file.config().actions[triggered_action];
-        execute_terminal_command(action.terminal_command);
-      }
     }
     verbose("---------------");
   }
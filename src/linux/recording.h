@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// Binary format written by keymapperd --record and read by keymapper-replay.
+// The header is followed by the events in the order they were read.
+// Activations of the context's override sets are recorded in between.
+const char recording_header[8] = { 'K', 'M', 'R', 'E', 'C', '0', '0', '2' };
+
+// type of a recorded context activation, value is the override set index
+const auto recorded_context_type = uint8_t{ 0xFF };
+
+struct RecordedEvent {
+  uint32_t time_delta_us; // since previous event by kernel timestamp, saturated
+  uint8_t device_id;      // number of /dev/input/event device
+  uint8_t type;
+  uint16_t code;
+  int32_t value;
+};
+static_assert(sizeof(RecordedEvent) == 12);
@@ -0,0 +1,220 @@
+
+#include "config/ParseConfig.h"
+#include "config/CreateStage.h"
+#include "config/Key.h"
+#include "runtime/Stage.h"
+#include "../recording.h"
+#include "../common.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <linux/input.h>
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  struct Settings {
+    std::string config_file_path;
+    std::string recording_file_path;
+    int context_index = -1;
+    bool realtime;
+  };
+
+  bool interpret_commandline(Settings& settings, int argc, char* argv[]) {
+    for (auto i = 1; i < argc; i++) {
+      const auto argument = std::string(argv[i]);
+      if (argument == "-c" || argument == "--config") {
+        if (++i >= argc)
+          return false;
+        settings.config_file_path = argv[i];
+      }
+      else if (argument == "--context") {
+        if (++i >= argc)
+          return false;
+        settings.context_index = std::atoi(argv[i]) - 1;
+      }
+      else if (argument == "--realtime") {
+        settings.realtime = true;
+      }
+      else if (settings.recording_file_path.empty() && argument[0] != '-') {
+        settings.recording_file_path = argument;
+      }
+      else {
+        return false;
+      }
+    }
+    return (!settings.config_file_path.empty() &&
+            !settings.recording_file_path.empty());
+  }
+
+  void print_help_message() {
+    std::printf(
+      "Usage: keymapper-replay -c <config> [-options] <recording>\n"
+      "  -c, --config <path>  configuration file.\n"
+      "  --context <n>        activate n-th context until one is recorded.\n"
+      "  --realtime           replay at recorded speed.\n"
+      "\n"
+      "Writes the output events to stdout and a report to stderr.\n"
+      "\n");
+  }
+
+  std::string read_file(const std::string& filename) {
+    auto file = std::ifstream(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), { });
+  }
+
+  bool read_recording(const std::string& filename,
+      std::vector<RecordedEvent>* events) {
+    const auto data = read_file(filename);
+    const auto header_size = sizeof(recording_header);
+    if (data.size() < header_size ||
+        std::memcmp(data.data(), recording_header, header_size) != 0 ||
+        (data.size() - header_size) % sizeof(RecordedEvent) != 0)
+      return false;
+    events->resize((data.size() - header_size) / sizeof(RecordedEvent));
+    std::memcpy(events->data(), data.data() + header_size,
+      events->size() * sizeof(RecordedEvent));
+    return true;
+  }
+
+  void print_event(double time_ms, const KeyEvent& event) {
+    const auto sign = (event.state == KeyState::Up ? '-' : '+');
+    if (is_action_key(event.key))
+      std::printf("%.3f %cAction%i\n", time_ms, sign,
+        event.key - first_action_key);
+    else
+      std::printf("%.3f %c%s\n", time_ms, sign,
+        std::string(get_key_name(static_cast<Key>(event.key))).c_str());
+  }
+
+  double percentile(const std::vector<double>& sorted, int percent) {
+    return sorted[sorted.size() * static_cast<size_t>(percent) / 100];
+  }
+} // namespace
+
+int main(int argc, char* argv[]) {
+  auto settings = Settings{ };
+  if (!interpret_commandline(settings, argc, argv)) {
+    print_help_message();
+    return 1;
+  }
+
+  auto config = Config{ };
+  try {
+    auto parse_config = ParseConfig();
+    const auto text = read_file(settings.config_file_path);
+    config = parse_config(text, true, settings.config_file_path);
+  }
+  catch (const std::exception& ex) {
+    error("%s", ex.what());
+    return 1;
+  }
+
+  auto events = std::vector<RecordedEvent>();
+  if (!read_recording(settings.recording_file_path, &events)) {
+    error("Reading recording '%s' failed",
+      settings.recording_file_path.c_str());
+    return 1;
+  }
+
+  auto stage = create_stage(config);
+  stage->activate_override_set(settings.context_index);
+
+  // apply the key events like keymapperd does
+  auto output_buffer = KeySequence{ };
+  auto output_down = std::vector<KeyCode>();
+  auto latencies_ns = std::vector<double>();
+  auto total_ns = 0.0;
+  auto time_us = uint64_t{ };
+  const auto start = Clock::now();
+
+  auto input_events = KeySequence{ };
+  auto key_events = size_t{ };
+  for (const auto& recorded : events) {
+    time_us += recorded.time_delta_us;
+    if (settings.realtime)
+      std::this_thread::sleep_until(start + std::chrono::microseconds(time_us));
+
+    if (recorded.type == recorded_context_type) {
+      stage->activate_override_set(recorded.value);
+      continue;
+    }
+
+    if (recorded.type == EV_KEY) {
+      // suppress key repeats after an OutputOnRelease event
+      if (recorded.value == 2 && !output_buffer.empty())
+        continue;
+
+      // key events are applied at end of frame
+      input_events.push_back({
+        static_cast<KeyCode>(recorded.code),
+        (recorded.value == 0 ? KeyState::Up : KeyState::Down),
+      });
+      continue;
+    }
+    if (recorded.type != EV_SYN || input_events.empty())
+      continue;
+
+    const auto time_ms = static_cast<double>(time_us) / 1000.0;
+    const auto send_event = [&](const KeyEvent& event) {
+      const auto it = std::find(output_down.begin(), output_down.end(), event.key);
+      if (event.state == KeyState::Up && it != output_down.end())
+        output_down.erase(it);
+      else if (event.state == KeyState::Down && it == output_down.end())
+        output_down.push_back(event.key);
+      print_event(time_ms, event);
+    };
+
+    // send rest of output buffer after an OutputOnRelease event
+    for (const auto& event : output_buffer)
+      if (event.state != KeyState::OutputOnRelease)
+        send_event(event);
+
+    stage->reuse_buffer(std::move(output_buffer));
+    const auto apply_start = Clock::now();
+    output_buffer = stage->apply_inputs(input_events.data(),
+      input_events.size());
+    const auto latency_ns = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - apply_start).count());
+    latencies_ns.push_back(latency_ns);
+    total_ns += latency_ns;
+    key_events += input_events.size();
+    input_events.clear();
+
+    auto it = output_buffer.begin();
+    for (; it != output_buffer.end(); ++it) {
+      // stop sending output on OutputOnRelease event
+      if (it->state == KeyState::OutputOnRelease)
+        break;
+      send_event(*it);
+    }
+    output_buffer.erase(output_buffer.begin(), it);
+  }
+  std::fflush(stdout);
+
+  std::fprintf(stderr, "Replayed %zu events, %zu key events in %zu frames "
+    "in %.3f s\n", events.size(), key_events, latencies_ns.size(),
+    static_cast<double>(time_us) / 1e6);
+  if (!latencies_ns.empty()) {
+    std::fprintf(stderr, "  throughput %.0f key events/s\n",
+      static_cast<double>(key_events) / (total_ns / 1e9));
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+    std::fprintf(stderr, "  frame latency min %.0f ns, median %.0f ns, "
+      "90%% %.0f ns, 99%% %.0f ns, max %.0f ns\n",
+      latencies_ns.front(), percentile(latencies_ns, 50),
+      percentile(latencies_ns, 90), percentile(latencies_ns, 99),
+      latencies_ns.back());
+  }
+  if (!output_down.empty()) {
+    std::fprintf(stderr, "  output keys still down:");
+    for (auto key : output_down)
+      std::fprintf(stderr, " %s",
+        std::string(get_key_name(static_cast<Key>(key))).c_str());
+    std::fprintf(stderr, "\n");
+  }
+}
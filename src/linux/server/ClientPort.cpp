@@ -1,6 +1,7 @@
 
 #include "ClientPort.h"
 #include "runtime/Stage.h"
+#include "runtime/trace.h"
 #include "../common.h"
 #include <unistd.h>
 #include <sys/select.h>
@@ -27,7 +28,16 @@ namespace {
     return true;
   }
 
-  std::unique_ptr<Stage> read_config(int fd) {
+  bool read_string(int fd, std::string* string) {
+    auto length = uint16_t{ };
+    if (!read(fd, &length))
+      return false;
+    string->resize(length);
+    return read_all(fd, string->data(), length);
+  }
+
+  std::unique_ptr<Stage> read_config(int fd,
+      std::vector<std::string>* mapping_sources) {
     // receive commands
     auto commmand_count = uint16_t{ };
     if (!read(fd, &commmand_count))
@@ -66,6 +76,21 @@ namespace {
       }
     }
 
+    // receive where mappings were defined
+    mapping_sources->clear();
+    auto filename = std::string();
+    for (auto i = 0; i < commmand_count; ++i) {
+      auto line_no = uint32_t{ };
+      if (!read(fd, &line_no) ||
+          !read_string(fd, &filename))
+        return nullptr;
+      auto source = (line_no == 0 ? std::string("default") :
+        "line " + std::to_string(line_no));
+      if (!filename.empty())
+        source += " of '" + filename + "'";
+      mapping_sources->push_back(std::move(source));
+    }
+
     return std::make_unique<Stage>(
       std::move(mappings), std::move(override_sets));
   }
@@ -94,12 +119,21 @@ bool ClientPort::initialize(const char* ipc_id) {
   return true;
 }
 
-std::unique_ptr<Stage> ClientPort::read_config() {
+bool ClientPort::accept() {
   m_client_fd = ::accept(m_socket_fd, nullptr, nullptr);
   if (m_client_fd < 0)
-    return nullptr;
+    return false;
+
+  auto credentials = ucred{ };
+  auto length = static_cast<socklen_t>(sizeof(credentials));
+  m_client_uid = (::getsockopt(m_client_fd, SOL_SOCKET, SO_PEERCRED,
+    &credentials, &length) == 0 ? credentials.uid : 0);
+  return true;
+}
 
-  return ::read_config(m_client_fd);
+std::unique_ptr<Stage> ClientPort::read_config() {
+  m_active_override_set = -1;
+  return ::read_config(m_client_fd, &m_mapping_sources);
 }
 
 bool ClientPort::receive_updates(Stage& stage) {
@@ -111,7 +145,9 @@ bool ClientPort::receive_updates(Stage& stage) {
   if (!read(m_client_fd, &activate_override_set))
     return false;
 
-  stage.activate_override_set(activate_override_set);
+  TRACE1(activate_override_set, activate_override_set);
+  m_active_override_set = static_cast<int>(activate_override_set);
+  stage.activate_override_set(m_active_override_set);
   return true;
 }
 
@@ -120,6 +156,7 @@ bool ClientPort::send_triggered_action(int action) {
 }
 
 void ClientPort::disconnect() {
+  m_client_uid = 0;
   if (m_client_fd >= 0) {
     ::close(m_client_fd);
     m_client_fd = -1;
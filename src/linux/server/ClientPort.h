@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 class Stage;
 
@@ -8,6 +11,9 @@ class ClientPort {
 private:
   int m_socket_fd{ -1 };
   int m_client_fd{ -1 };
+  std::vector<std::string> m_mapping_sources;
+  int m_active_override_set{ -1 };
+  uint32_t m_client_uid{ };
 
 public:
   ClientPort() = default;
@@ -16,8 +22,14 @@ public:
   ~ClientPort();
 
   bool initialize(const char* ipc_id);
+  bool accept();
   std::unique_ptr<Stage> read_config();
   bool receive_updates(Stage& stage);
   bool send_triggered_action(int action);
   void disconnect();
+  int active_override_set() const { return m_active_override_set; }
+  // user of the connected keymapper
+  uint32_t client_uid() const { return m_client_uid; }
+  // where the mappings of the last configuration were defined
+  const std::vector<std::string>& mapping_sources() const { return m_mapping_sources; }
 };
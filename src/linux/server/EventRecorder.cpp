@@ -0,0 +1,59 @@
+
+#include "EventRecorder.h"
+#include "../recording.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+EventRecorder::~EventRecorder() {
+  if (m_file)
+    std::fclose(m_file);
+}
+
+bool EventRecorder::open(const std::string& filename) {
+  // the recording contains everything which was typed
+  const auto fd = ::open(filename.c_str(),
+    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    return false;
+  if (::fchmod(fd, S_IRUSR | S_IWUSR) != 0 ||
+      !(m_file = ::fdopen(fd, "wb"))) {
+    ::close(fd);
+    return false;
+  }
+  ::gettimeofday(&m_previous, nullptr);
+  return (std::fwrite(recording_header, sizeof(recording_header), 1,
+    m_file) == 1);
+}
+
+bool EventRecorder::record(const timeval& time, int device_id, int type,
+    int code, int value) {
+  return write(time, device_id, type, code, value);
+}
+
+bool EventRecorder::record_context(int override_set_index) {
+  // evdev timestamps use the realtime clock by default
+  auto time = timeval{ };
+  ::gettimeofday(&time, nullptr);
+  return write(time, 0, recorded_context_type, 0, override_set_index);
+}
+
+bool EventRecorder::write(const timeval& time, int device_id, int type,
+    int code, int value) {
+  const auto delta = std::max(int64_t{ },
+    (int64_t{ time.tv_sec } - m_previous.tv_sec) * 1000000 +
+    (time.tv_usec - m_previous.tv_usec));
+  m_previous = time;
+
+  const auto event = RecordedEvent{
+    static_cast<uint32_t>(std::min<int64_t>(delta, UINT32_MAX)),
+    static_cast<uint8_t>(device_id),
+    static_cast<uint8_t>(type),
+    static_cast<uint16_t>(code),
+    static_cast<int32_t>(value),
+  };
+  // flush every event, so nothing is lost when keymapperd is killed
+  return (std::fwrite(&event, sizeof(event), 1, m_file) == 1 &&
+          std::fflush(m_file) == 0);
+}
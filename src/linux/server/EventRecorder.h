@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <sys/time.h>
+
+class EventRecorder {
+private:
+  std::FILE* m_file{ };
+  timeval m_previous{ };
+
+public:
+  EventRecorder() = default;
+  EventRecorder(const EventRecorder&) = delete;
+  EventRecorder& operator=(const EventRecorder&) = delete;
+  ~EventRecorder();
+
+  bool open(const std::string& filename);
+  bool is_open() const { return (m_file != nullptr); }
+  bool record(const timeval& time, int device_id, int type, int code,
+    int value);
+  bool record_context(int override_set_index);
+
+private:
+  bool write(const timeval& time, int device_id, int type, int code,
+    int value);
+};
@@ -0,0 +1,68 @@
+
+#include "FlightRecorder.h"
+#include "config/Key.h"
+#include <algorithm>
+
+namespace {
+  std::string format_key(KeyCode key) {
+    if (is_action_key(key))
+      return "Action" + std::to_string(key - first_action_key);
+    const auto name = get_key_name(static_cast<Key>(key));
+    if (name.empty())
+      return "#" + std::to_string(key);
+    return std::string(name);
+  }
+
+  char format_state(int32_t state) {
+    switch (static_cast<KeyState>(state)) {
+      case KeyState::Up: return '-';
+      case KeyState::Down: return '+';
+      case KeyState::Not: return '!';
+      case KeyState::UpAsync: return '~';
+      case KeyState::DownAsync: return '*';
+      case KeyState::OutputOnRelease: return '^';
+      case KeyState::DownMatched: return '#';
+    }
+    return '?';
+  }
+} // namespace
+
+void FlightRecorder::dump(std::FILE* file, const char* reason,
+    const std::vector<std::string>& mapping_sources) const {
+  const auto count = std::min(m_next, capacity);
+  std::fprintf(file, "Flight recorder dump (%s), last %zu entries:\n",
+    reason, count);
+
+  for (auto i = m_next - count; i != m_next; ++i) {
+    const auto& entry = m_entries[i & (capacity - 1)];
+    std::fprintf(file, "%12.6f ", static_cast<double>(entry.time_us) / 1e6);
+    switch (entry.type) {
+      case Type::Input:
+        // value of evdev key event
+        std::fprintf(file, "input   %s%s\n",
+          (entry.value == 0 ? "-" : entry.value == 1 ? "+" : "repeat "),
+          format_key(entry.key).c_str());
+        break;
+      case Type::Match: {
+        const auto index = static_cast<size_t>(entry.value);
+        std::fprintf(file, "match   mapping #%i %s\n", entry.value,
+          index < mapping_sources.size() ? mapping_sources[index].c_str() : "");
+        break;
+      }
+      case Type::HeldBack:
+        std::fprintf(file, "held    sequence might match\n");
+        break;
+      case Type::Output:
+        std::fprintf(file, "output  %c%s\n", format_state(entry.value),
+          format_key(entry.key).c_str());
+        break;
+      case Type::OutputOnRelease:
+        std::fprintf(file, "held    output until release\n");
+        break;
+      case Type::Connected:
+        std::fprintf(file, "connected, %i mappings\n", entry.value);
+        break;
+    }
+  }
+  std::fflush(file);
+}
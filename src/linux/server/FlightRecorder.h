@@ -0,0 +1,53 @@
+#pragma once
+
+#include "runtime/KeyEvent.h"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Always-on record of the recent input, Stage decisions and output, which
+// is dumped when a problem is reported. Recording only writes into a
+// fixed-size ring buffer, entries are only formatted when dumping.
+class FlightRecorder {
+public:
+  enum class Type : uint16_t {
+    Input, Match, HeldBack, Output, OutputOnRelease, Connected,
+  };
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Entry {
+    uint32_t time_us;
+    Type type;
+    KeyCode key;
+    int32_t value;
+  };
+  static constexpr auto capacity = size_t{ 4096 };
+  static_assert((capacity & (capacity - 1)) == 0);
+
+  const Clock::time_point m_start{ Clock::now() };
+  std::array<Entry, capacity> m_entries;
+  size_t m_next{ };
+  uint32_t m_now_us{ };
+
+public:
+  // sets the time of the following entries
+  void update_time() {
+    m_now_us = static_cast<uint32_t>(std::chrono::duration_cast<
+      std::chrono::microseconds>(Clock::now() - m_start).count());
+  }
+
+  void record(Type type, KeyCode key = { }, int32_t value = { }) {
+    m_entries[m_next++ & (capacity - 1)] = { m_now_us, type, key, value };
+  }
+
+  void record_output(const KeyEvent& event) {
+    record(Type::Output, event.key, static_cast<int32_t>(event.state));
+  }
+
+  void dump(std::FILE* file, const char* reason,
+    const std::vector<std::string>& mapping_sources) const;
+};
@@ -1,5 +1,7 @@
 
 #include "GrabbedKeyboards.h"
+#include "Metrics.h"
+#include "runtime/trace.h"
 #include "../common.h"
 #include <vector>
 #include <cstdio>
@@ -113,7 +115,8 @@ namespace {
   }
 
   bool read_event(const std::vector<int>& fds, int cancel_fd,
-      int* type, int* code, int* value, bool* cancelled) {
+      int* fd_index, int* type, int* code, int* value, timeval* time,
+      bool* cancelled) {
 
     auto rfds = fd_set{ };
     FD_ZERO(&rfds);
@@ -136,14 +139,17 @@ namespace {
       return false;
     }
 
-    for (auto fd : fds)
-      if (FD_ISSET(fd, &rfds)) {
+    for (auto i = 0u; i < fds.size(); ++i)
+      if (FD_ISSET(fds[i], &rfds)) {
         auto ev = input_event{ };
-        if (!read_all(fd, reinterpret_cast<char*>(&ev), sizeof(input_event)))
+        if (!read_all(fds[i], reinterpret_cast<char*>(&ev), sizeof(input_event)))
           return false;
+        *fd_index = static_cast<int>(i);
         *type = ev.type;
         *code = ev.code;
         *value = ev.value;
+        if (time)
+          *time = ev.time;
         return true;
       }
 
@@ -154,9 +160,11 @@ namespace {
 class GrabbedKeyboards {
 private:
   const char* m_ignore_device_name = "";
+  Metrics* m_metrics{ };
   int m_device_monitor_fd{ -1 };
   std::vector<int> m_event_fds;
   std::vector<int> m_grabbed_keyboard_fds;
+  std::vector<int> m_grabbed_keyboard_ids;
 
 public:
   ~GrabbedKeyboards() {
@@ -174,8 +182,13 @@ public:
     return m_grabbed_keyboard_fds;
   }
 
-  bool initialize(const char* ignore_device_name) {
+  const std::vector<int>& grabbed_keyboard_ids() const {
+    return m_grabbed_keyboard_ids;
+  }
+
+  bool initialize(const char* ignore_device_name, Metrics* metrics) {
     m_ignore_device_name = ignore_device_name;
+    m_metrics = metrics;
     m_event_fds.resize(EVDEV_MINORS, -1);
     update();
     return true;
@@ -201,6 +214,8 @@ public:
         wait_until_keys_released(fd);
         if (grab_event_device(fd, true)) {
           event_fd = ::dup(fd);
+          if (m_metrics)
+            Metrics::add(m_metrics->device_grabs);
         }
         else {
           error("Grabbing device failed");
@@ -216,6 +231,8 @@ public:
       grab_event_device(event_fd, false);
       ::close(event_fd);
       event_fd = -1;
+      if (m_metrics)
+        Metrics::add(m_metrics->device_releases);
     }
   }
 
@@ -239,9 +256,12 @@ public:
 
     // collect grabbed keyboard fds
     m_grabbed_keyboard_fds.clear();
-    for (auto event_fd : m_event_fds)
-      if (event_fd >= 0)
-        m_grabbed_keyboard_fds.push_back(event_fd);
+    m_grabbed_keyboard_ids.clear();
+    for (auto event_id = 0; event_id < EVDEV_MINORS; ++event_id)
+      if (m_event_fds[event_id] >= 0) {
+        m_grabbed_keyboard_fds.push_back(m_event_fds[event_id]);
+        m_grabbed_keyboard_ids.push_back(event_id);
+      }
 
     // reset device monitor
     release_device_monitor();
@@ -253,20 +273,27 @@ void FreeGrabbedKeyboards::operator()(GrabbedKeyboards* keyboards) {
   delete keyboards;
 }
 
-GrabbedKeyboardsPtr grab_keyboards(const char* ignore_device_name) {
+GrabbedKeyboardsPtr grab_keyboards(const char* ignore_device_name,
+    Metrics* metrics) {
   auto keyboards = GrabbedKeyboardsPtr(new GrabbedKeyboards());
-  if (!keyboards->initialize(ignore_device_name))
+  if (!keyboards->initialize(ignore_device_name, metrics))
     return nullptr;
   return keyboards;
 }
 
-bool read_keyboard_event(GrabbedKeyboards& keyboards, int* type, int* code, int* value) {
+bool read_keyboard_event(GrabbedKeyboards& keyboards, int* device_id,
+    int* type, int* code, int* value, timeval* time) {
   for (;;) {
     auto devices_changed = false;
+    auto fd_index = 0;
     if (read_event(keyboards.grabbed_keyboard_fds(),
-          keyboards.device_monitor_fd(), type, code, value,
-          &devices_changed))
+          keyboards.device_monitor_fd(), &fd_index, type, code, value,
+          time, &devices_changed)) {
+      *device_id = keyboards.grabbed_keyboard_ids()[
+        static_cast<size_t>(fd_index)];
+      TRACE4(read_event, *device_id, *type, *code, *value);
       return true;
+    }
 
     if (!devices_changed)
       return false;
@@ -3,8 +3,13 @@
 #include <memory>
 
 class GrabbedKeyboards;
+struct Metrics;
+struct timeval;
 struct FreeGrabbedKeyboards { void operator()(GrabbedKeyboards* keyboards); };
 using GrabbedKeyboardsPtr = std::unique_ptr<GrabbedKeyboards, FreeGrabbedKeyboards>;
 
-GrabbedKeyboardsPtr grab_keyboards(const char* ignore_device_name);
-bool read_keyboard_event(GrabbedKeyboards& keyboards, int* type, int* code, int* value);
+GrabbedKeyboardsPtr grab_keyboards(const char* ignore_device_name,
+  Metrics* metrics = nullptr);
+// time is set to the kernel's timestamp of the event, when not null
+bool read_keyboard_event(GrabbedKeyboards& keyboards, int* device_id,
+  int* type, int* code, int* value, timeval* time = nullptr);
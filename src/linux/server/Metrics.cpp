@@ -0,0 +1,179 @@
+
+#include "Metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <csignal>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace {
+  uint64_t get(const Metrics::Counter& counter) {
+    return counter.load(std::memory_order_relaxed);
+  }
+
+  void append(std::string& text, const char* format, ...)
+      __attribute__((format(printf, 2, 3)));
+
+  void append(std::string& text, const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    const auto length = std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length > 0)
+      text.append(buffer, std::min(static_cast<size_t>(length),
+        sizeof(buffer) - 1));
+  }
+
+  void send_all(int fd, const std::string& text) {
+    auto sent = size_t{ };
+    while (sent < text.size()) {
+      // do not raise SIGPIPE, when the client already disconnected
+      const auto result = ::send(fd, text.data() + sent, text.size() - sent,
+        MSG_NOSIGNAL);
+      if (result < 0 && errno == EINTR)
+        continue;
+      if (result <= 0)
+        return;
+      sent += static_cast<size_t>(result);
+    }
+  }
+
+  void append_counter(std::string& text, const char* name,
+      const char* help, uint64_t value) {
+    append(text, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+      name, help, name, name, static_cast<unsigned long long>(value));
+  }
+} // namespace
+
+void Metrics::add_latency(std::chrono::steady_clock::duration latency) {
+  const auto ns = static_cast<uint64_t>(std::chrono::duration_cast<
+    std::chrono::nanoseconds>(latency).count());
+  auto bucket = 0;
+  for (auto us = ns / 1000; us != 0 && bucket < latency_buckets - 1; us >>= 1)
+    ++bucket;
+  add(latency_us[static_cast<size_t>(bucket)]);
+  add(latency_sum_ns, ns);
+}
+
+std::string format_metrics(const Metrics& metrics) {
+  auto text = std::string();
+  append(text, "# HELP keymapperd_events_in_total "
+    "Events read from keyboard devices.\n"
+    "# TYPE keymapperd_events_in_total counter\n");
+  for (auto i = 0; i < Metrics::max_devices; ++i)
+    if (const auto value = get(metrics.events_in[static_cast<size_t>(i)]))
+      append(text, "keymapperd_events_in_total{device=\"event%i\"} %llu\n",
+        i, static_cast<unsigned long long>(value));
+
+  append_counter(text, "keymapperd_events_out_total",
+    "Key events sent to the uinput device.", get(metrics.events_out));
+  append_counter(text, "keymapperd_held_back_total",
+    "Key events which were held back, because a mapping might match.",
+    get(metrics.held_back));
+  append_counter(text, "keymapperd_syn_dropped_total",
+    "Events dropped by the kernel (SYN_DROPPED).", get(metrics.syn_dropped));
+  append_counter(text, "keymapperd_client_connects_total",
+    "Connections of keymapper.", get(metrics.client_connects));
+  append_counter(text, "keymapperd_device_grabs_total",
+    "Keyboard devices grabbed.", get(metrics.device_grabs));
+  append_counter(text, "keymapperd_device_releases_total",
+    "Keyboard devices released.", get(metrics.device_releases));
+  append_counter(text, "keymapperd_config_loads_total",
+    "Configurations received.", get(metrics.config_loads));
+  append(text, "# HELP keymapperd_last_config_load_seconds "
+    "Time to receive and activate the last configuration.\n"
+    "# TYPE keymapperd_last_config_load_seconds gauge\n"
+    "keymapperd_last_config_load_seconds %.6f\n",
+    static_cast<double>(get(metrics.last_config_load_ns)) / 1e9);
+
+  // quantiles are the upper bounds of the latency buckets
+  auto buckets = std::array<uint64_t, Metrics::latency_buckets>();
+  auto count = uint64_t{ };
+  for (auto i = 0u; i < buckets.size(); ++i)
+    count += (buckets[i] = get(metrics.latency_us[i]));
+  append(text, "# HELP keymapperd_latency_seconds "
+    "Time from reading the first key event of a frame until the output "
+    "was flushed.\n"
+    "# TYPE keymapperd_latency_seconds summary\n");
+  for (auto quantile : { 0.5, 0.9, 0.99 }) {
+    auto bucket = 0u;
+    for (auto sum = uint64_t{ }; bucket < buckets.size(); ++bucket)
+      if ((sum += buckets[bucket]) >= quantile * static_cast<double>(count))
+        break;
+    append(text, "keymapperd_latency_seconds{quantile=\"%g\"} %.6f\n",
+      quantile, (count ? static_cast<double>(1ull << bucket) / 1e6 : 0.0));
+  }
+  append(text, "keymapperd_latency_seconds_sum %.9f\n"
+    "keymapperd_latency_seconds_count %llu\n",
+    static_cast<double>(get(metrics.latency_sum_ns)) / 1e9,
+    static_cast<unsigned long long>(count));
+  return text;
+}
+
+MetricsServer::MetricsServer(const Metrics& metrics)
+  : m_metrics(metrics) {
+}
+
+MetricsServer::~MetricsServer() {
+  if (m_socket_fd >= 0) {
+    // wakes up accept
+    ::shutdown(m_socket_fd, SHUT_RDWR);
+    if (m_thread.joinable())
+      m_thread.join();
+    ::close(m_socket_fd);
+  }
+}
+
+bool MetricsServer::initialize(const char* ipc_id) {
+  m_socket_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (m_socket_fd < 0)
+    return false;
+
+  auto addr = sockaddr_un{ };
+  addr.sun_family = AF_UNIX;
+  ::strncpy(&addr.sun_path[1], ipc_id, sizeof(addr.sun_path) - 2);
+  // not padded with zeroes, so tools like socat can connect by name
+  const auto length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) +
+    1 + std::strlen(&addr.sun_path[1]));
+  if (::bind(m_socket_fd, reinterpret_cast<sockaddr*>(&addr), length) != 0 ||
+      ::listen(m_socket_fd, 4) != 0)
+    return false;
+
+  // signals should only interrupt the main thread
+  auto signals = sigset_t{ };
+  auto previous = sigset_t{ };
+  sigfillset(&signals);
+  ::pthread_sigmask(SIG_BLOCK, &signals, &previous);
+  m_thread = std::thread(&MetricsServer::serve, this);
+  ::pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+  return true;
+}
+
+void MetricsServer::set_client_uid(uint32_t uid) {
+  m_client_uid.store(uid, std::memory_order_relaxed);
+}
+
+void MetricsServer::serve() {
+  for (;;) {
+    const auto fd = ::accept4(m_socket_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return;
+    }
+    auto credentials = ucred{ };
+    auto length = static_cast<socklen_t>(sizeof(credentials));
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED,
+          &credentials, &length) == 0 &&
+        (credentials.uid == 0 ||
+         credentials.uid == m_client_uid.load(std::memory_order_relaxed)))
+      send_all(fd, format_metrics(m_metrics));
+    ::close(fd);
+  }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// Counters which are only updated by the main loop and read by the
+// metrics endpoint's thread.
+struct Metrics {
+  using Counter = std::atomic<uint64_t>;
+  static constexpr auto max_devices = 32;
+  static constexpr auto latency_buckets = 32;
+
+  std::array<Counter, max_devices> events_in{ };
+  Counter events_out{ };
+  Counter held_back{ };
+  Counter syn_dropped{ };
+  Counter client_connects{ };
+  Counter device_grabs{ };
+  Counter device_releases{ };
+  Counter config_loads{ };
+  Counter last_config_load_ns{ };
+  // time from reading a key event until the output was flushed,
+  // bucket i counts the latencies below 2^i microseconds
+  std::array<Counter, latency_buckets> latency_us{ };
+  Counter latency_sum_ns{ };
+
+  // there is a single writer, so no read-modify-write is necessary
+  static void add(Counter& counter, uint64_t value = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+      std::memory_order_relaxed);
+  }
+
+  void add_latency(std::chrono::steady_clock::duration latency);
+};
+
+std::string format_metrics(const Metrics& metrics);
+
+// Serves the metrics in Prometheus text format on an abstract Unix socket,
+// each connection receives the current values and is closed. Since the
+// key event counters reveal the typing rhythm, only root and the user of
+// the connected keymapper are answered.
+class MetricsServer {
+private:
+  const Metrics& m_metrics;
+  int m_socket_fd{ -1 };
+  std::thread m_thread;
+  std::atomic<uint32_t> m_client_uid{ };
+
+public:
+  explicit MetricsServer(const Metrics& metrics);
+  MetricsServer(const MetricsServer&) = delete;
+  MetricsServer& operator=(const MetricsServer&) = delete;
+  ~MetricsServer();
+
+  bool initialize(const char* ipc_id);
+  // 0 when no keymapper is connected
+  void set_client_uid(uint32_t uid);
+
+private:
+  void serve();
+};
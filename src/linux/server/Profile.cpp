@@ -0,0 +1,75 @@
+
+#include "Profile.h"
+#include "runtime/Stage.h"
+#include <cstdio>
+#include <cinttypes>
+
+namespace {
+  const auto profile_header = "keymapper-profile";
+
+  // counts only apply to the mappings they were recorded for
+  uint64_t get_mappings_hash(const std::vector<Mapping>& mappings) {
+    auto hash = uint64_t{ 14695981039346656037ull };
+    const auto add = [&](uint64_t value) {
+      hash ^= value;
+      hash *= 1099511628211ull;
+    };
+    for (const auto& mapping : mappings) {
+      add(mapping.input.size());
+      for (const auto& event : mapping.input)
+        add((static_cast<uint64_t>(event.state) << 16) | event.key);
+    }
+    return hash;
+  }
+} // namespace
+
+bool load_profile(const std::string& filename, Stage& stage) {
+  auto file = std::fopen(filename.c_str(), "r");
+  if (!file)
+    return false;
+
+  const auto& mappings = stage.mappings();
+  auto hash = uint64_t{ };
+  auto count = size_t{ };
+  auto match_counts = std::vector<uint32_t>();
+  auto header = std::string(profile_header);
+  header += " %" SCNx64 " %zu";
+  if (std::fscanf(file, header.c_str(), &hash, &count) == 2 &&
+      hash == get_mappings_hash(mappings) &&
+      count == mappings.size()) {
+    match_counts.resize(count);
+    for (auto& match_count : match_counts)
+      if (std::fscanf(file, "%" SCNu32, &match_count) != 1) {
+        match_counts.clear();
+        break;
+      }
+  }
+  std::fclose(file);
+
+  if (match_counts.empty())
+    return false;
+  stage.reorder_mappings(std::move(match_counts));
+  return true;
+}
+
+bool save_profile(const std::string& filename, const Stage& stage) {
+  // write to temporary file and replace profile at once
+  const auto temp_filename = filename + ".tmp";
+  auto file = std::fopen(temp_filename.c_str(), "w");
+  if (!file)
+    return false;
+
+  const auto& match_counts = stage.match_counts();
+  auto succeeded = (std::fprintf(file, "%s %" PRIx64 " %zu\n", profile_header,
+    get_mappings_hash(stage.mappings()), match_counts.size()) > 0);
+  for (auto match_count : match_counts)
+    if (succeeded)
+      succeeded = (std::fprintf(file, "%" PRIu32 "\n", match_count) > 0);
+
+  if (std::fclose(file) != 0 || !succeeded ||
+      std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+    std::remove(temp_filename.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+class Stage;
+
+bool load_profile(const std::string& filename, Stage& stage);
+bool save_profile(const std::string& filename, const Stage& stage);
@@ -8,6 +8,19 @@ bool interpret_commandline(Settings& settings, int argc, char* argv[]) {
     if (argument == "-v" || argument == "--verbose") {
       settings.verbose = true;
     }
+    else if (argument == "--profile") {
+      if (++i >= argc)
+        return false;
+      settings.profile_file_path = argv[i];
+    }
+    else if (argument == "--metrics") {
+      settings.metrics = true;
+    }
+    else if (argument == "--record") {
+      if (++i >= argc)
+        return false;
+      settings.record_file_path = argv[i];
+    }
     else {
       return false;
     }
@@ -35,6 +48,9 @@ void print_help_message(const char* argv0) {
     "\n"
     "Usage: %s [-options]\n"
     "  -v, --verbose        enable verbose output.\n"
+    "  --profile <path>     record mapping usage and optimize lookup order.\n"
+    "  --record <path>      record input events for keymapper-replay.\n"
+    "  --metrics            serve metrics on socket 'keymapper-metrics'.\n"
     "  -h, --help           print this help.\n"
     "\n"
     "All Rights Reserved.\n"
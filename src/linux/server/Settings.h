@@ -4,6 +4,9 @@
 
 struct Settings {
   bool verbose;
+  std::string profile_file_path;
+  std::string record_file_path;
+  bool metrics;
 };
 
 bool interpret_commandline(Settings& settings, int argc, char* argv[]);
@@ -3,13 +3,59 @@
 #include "GrabbedKeyboards.h"
 #include "uinput_keyboard.h"
 #include "Settings.h"
+#include "Profile.h"
+#include "EventRecorder.h"
+#include "FlightRecorder.h"
+#include "Metrics.h"
 #include "runtime/Stage.h"
 #include "../common.h"
 #include <linux/uinput.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
 
 namespace {
   const auto ipc_id = "keymapper";
+  const auto metrics_ipc_id = "keymapper-metrics";
   const auto uinput_keyboard_name = "Keymapper";
+
+  using Clock = std::chrono::steady_clock;
+
+  volatile std::sig_atomic_t g_shutdown;
+  volatile std::sig_atomic_t g_dump_requested;
+
+#if defined(ENABLE_STATISTICS)
+  void print_statistics(const Stage& stage,
+      const std::vector<std::string>& mapping_sources) {
+    std::printf("%-30s %12s %12s %12s %14s\n", "Mapping",
+      "tested", "matched", "might match", "matcher steps");
+    const auto& statistics = stage.statistics();
+    for (auto i = 0u; i < statistics.size(); ++i)
+      std::printf("%-30s %12llu %12llu %12llu %14llu\n",
+        (i < mapping_sources.size() ? mapping_sources[i].c_str() : ""),
+        static_cast<unsigned long long>(statistics[i].tested),
+        static_cast<unsigned long long>(statistics[i].matched),
+        static_cast<unsigned long long>(statistics[i].might_matched),
+        static_cast<unsigned long long>(statistics[i].matcher_steps));
+    std::fflush(stdout);
+  }
+#endif
+
+  void catch_termination_signals() {
+    // interrupt blocking reads, so the profile can be saved
+    struct sigaction action{ };
+    action.sa_handler = [](int) { g_shutdown = 1; };
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+  }
+
+  void catch_dump_signal() {
+    // interrupts blocking reads, the dump is written by the main loop
+    struct sigaction action{ };
+    action.sa_handler = [](int) { g_dump_requested = 1; };
+    ::sigaction(SIGUSR1, &action, nullptr);
+  }
 }
 
 int main(int argc, char* argv[]) {
@@ -21,6 +67,25 @@ int main(int argc, char* argv[]) {
   }
   g_verbose_output = settings.verbose;
 
+  if (!settings.profile_file_path.empty())
+    catch_termination_signals();
+  catch_dump_signal();
+  auto flight_recorder = FlightRecorder();
+
+  auto recorder = EventRecorder();
+  if (!settings.record_file_path.empty() &&
+      !recorder.open(settings.record_file_path)) {
+    error("Opening recording '%s' failed", settings.record_file_path.c_str());
+    return 1;
+  }
+
+  auto metrics = Metrics();
+  auto metrics_server = MetricsServer(metrics);
+  if (settings.metrics && !metrics_server.initialize(metrics_ipc_id)) {
+    error("Initializing metrics endpoint failed");
+    return 1;
+  }
+
   auto client = ClientPort();
   if (!client.initialize(ipc_id)) {
     error("Initializing keymapper connection failed");
@@ -30,8 +95,30 @@ int main(int argc, char* argv[]) {
   // wait for client connection loop
   for (;;) {
     verbose("Waiting for keymapper to connect");
-    const auto stage = client.read_config();
+    const auto connected = client.accept();
+    metrics_server.set_client_uid(client.client_uid());
+    const auto config_start = Clock::now();
+    const auto stage = (connected ? client.read_config() : nullptr);
     if (stage) {
+      Metrics::add(metrics.client_connects);
+      flight_recorder.update_time();
+      flight_recorder.record(FlightRecorder::Type::Connected, { },
+        static_cast<int32_t>(stage->mappings().size()));
+      verbose("Output tables of %zu mappings in %zu contexts take %zu bytes",
+        stage->mappings().size(), stage->override_sets().size(),
+        stage->output_tables_size());
+
+      if (!settings.profile_file_path.empty()) {
+        if (load_profile(settings.profile_file_path, *stage))
+          verbose("Reordered mappings according to profile");
+        else
+          verbose("No matching profile found");
+      }
+      Metrics::add(metrics.config_loads);
+      metrics.last_config_load_ns.store(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          Clock::now() - config_start).count()), std::memory_order_relaxed);
+
       // client connected
       verbose("Creating uinput keyboard '%s'", uinput_keyboard_name);
       const auto uinput_fd = create_uinput_keyboard(uinput_keyboard_name);
@@ -40,7 +127,8 @@ int main(int argc, char* argv[]) {
         return 1;
       }
 
-      const auto grabbed_keyboards = grab_keyboards(uinput_keyboard_name);
+      const auto grabbed_keyboards = grab_keyboards(uinput_keyboard_name,
+        &metrics);
       if (!grabbed_keyboards) {
         error("Initializing keyboard grabbing failed");
         return 1;
@@ -49,75 +137,183 @@ int main(int argc, char* argv[]) {
       // main loop
       verbose("Entering update loop");
       auto output_buffer = KeySequence{ };
+      auto input_events = KeySequence{ };
+      auto other_events = std::vector<input_event>();
+      const auto send_other_events = [&]() {
+        for (const auto& event : other_events)
+          send_event(uinput_fd, event.type, event.code, event.value);
+        other_events.clear();
+      };
+      auto frame_start = Clock::time_point();
+      auto down_keys = std::vector<KeyCode>();
+      auto stuck_output_reported = false;
       for (;;) {
         // wait for next key event
+        auto device_id = 0;
         auto type = 0;
         auto code = 0;
         auto value = 0;
-        if (!read_keyboard_event(*grabbed_keyboards, &type, &code, &value)) {
+        auto time = timeval{ };
+        if (!read_keyboard_event(*grabbed_keyboards,
+              &device_id, &type, &code, &value, &time)) {
+          if (errno == EINTR && !g_shutdown) {
+            if (g_dump_requested) {
+              g_dump_requested = 0;
+              flight_recorder.dump(stderr, "requested",
+                client.mapping_sources());
+            }
+            continue;
+          }
           verbose("Reading keyboard event failed");
           break;
         }
 
+        const auto event_read = (settings.metrics ?
+          Clock::now() : Clock::time_point());
+        if (device_id < Metrics::max_devices)
+          Metrics::add(metrics.events_in[static_cast<size_t>(device_id)]);
+        if (type == EV_SYN && code == SYN_DROPPED)
+          Metrics::add(metrics.syn_dropped);
+
+        if (recorder.is_open() &&
+            !recorder.record(time, device_id, type, code, value)) {
+          error("Writing recording failed");
+          return 1;
+        }
+
         // let client update configuration
-        if (!stage->is_output_down())
+        if (!stage->is_output_down()) {
+          const auto override_set = client.active_override_set();
           if (!client.receive_updates(*stage)) {
             verbose("Connection to keymapper reset");
             break;
           }
+          if (recorder.is_open() &&
+              client.active_override_set() != override_set &&
+              !recorder.record_context(client.active_override_set())) {
+            error("Writing recording failed");
+            return 1;
+          }
+        }
 
         if (type == EV_KEY) {
+          flight_recorder.update_time();
+          flight_recorder.record(FlightRecorder::Type::Input,
+            static_cast<KeyCode>(code), value);
+
+          // suppress key repeats after an OutputOnRelease event
+          if (value == 2 && !output_buffer.empty())
+            continue;
+
+          // translate key events, they are applied at end of frame
+          if (input_events.empty())
+            frame_start = event_read;
+          input_events.push_back({
+            static_cast<KeyCode>(code),
+            (value == 0 ? KeyState::Up : KeyState::Down),
+          });
+        }
+        else if (type == EV_SYN) {
+          if (input_events.empty()) {
+            if (!other_events.empty()) {
+              send_other_events();
+              flush_events(uinput_fd);
+            }
+            continue;
+          }
+
           const auto send_event = [&](const KeyEvent& event) {
+            flight_recorder.record_output(event);
             if (!is_action_key(event.key)) {
               send_key_event(uinput_fd, event);
+              Metrics::add(metrics.events_out);
             }
             else if (event.state == KeyState::Down) {
               client.send_triggered_action(event.key - first_action_key);
             }
           };
 
-          // translate key events
-          const auto event = KeyEvent{
-            static_cast<KeyCode>(code),
-            (value == 0 ? KeyState::Up : KeyState::Down),
-          };
-
-          // after an OutputOnRelease event?
-          if (!output_buffer.empty()) {
-            // suppress key repeats
-            if (value == 2)
-              continue;
-
-            // send rest of output buffer
-            for (const auto& event : output_buffer)
-              if (event.state != KeyState::OutputOnRelease)
-                send_event(event);
-          }
+          // send rest of output buffer after an OutputOnRelease event
+          for (const auto& event : output_buffer)
+            if (event.state != KeyState::OutputOnRelease)
+              send_event(event);
 
-          // apply input
+          // apply all input events of frame
           stage->reuse_buffer(std::move(output_buffer));
-          output_buffer = stage->apply_input(event);
+          output_buffer = stage->apply_inputs(input_events.data(),
+            input_events.size());
+          if (stage->last_matched_mapping() >= 0)
+            flight_recorder.record(FlightRecorder::Type::Match, { },
+              stage->last_matched_mapping());
+          if (stage->is_sequence_held_back()) {
+            flight_recorder.record(FlightRecorder::Type::HeldBack);
+            Metrics::add(metrics.held_back);
+          }
 
           auto it = output_buffer.begin();
           for (; it != output_buffer.end(); ++it) {
             // stop sending output on OutputOnRelease event
-            if (it->state == KeyState::OutputOnRelease)
+            if (it->state == KeyState::OutputOnRelease) {
+              flight_recorder.record(FlightRecorder::Type::OutputOnRelease);
               break;
+            }
             send_event(*it);
           }
+          send_other_events();
           flush_events(uinput_fd);
           output_buffer.erase(output_buffer.begin(), it);
+          if (settings.metrics)
+            metrics.add_latency(Clock::now() - frame_start);
+
+          // output should be released, when no key is hold anymore
+          for (const auto& event : input_events) {
+            const auto down = std::find(down_keys.begin(), down_keys.end(),
+              event.key);
+            if (event.state == KeyState::Down && down == down_keys.end())
+              down_keys.push_back(event.key);
+            else if (event.state == KeyState::Up && down != down_keys.end())
+              down_keys.erase(down);
+          }
+          input_events.clear();
+          if (!down_keys.empty() || !stage->is_output_down()) {
+            stuck_output_reported = false;
+          }
+          else if (!stuck_output_reported) {
+            // the record contains what was typed, only dump it on request
+            stuck_output_reported = true;
+            if (settings.verbose)
+              flight_recorder.dump(stderr, "output still down",
+                client.mapping_sources());
+          }
         }
-        else if (type != EV_SYN &&
-                 type != EV_MSC) {
-          // forward other events
-          send_event(uinput_fd, type, code, value);
+        else if (type != EV_MSC) {
+          // forward other events after the output of the frame's key events
+          auto& event = other_events.emplace_back();
+          event.type = static_cast<unsigned short>(type);
+          event.code = static_cast<unsigned short>(code);
+          event.value = value;
         }
       }
       verbose("Destroying uinput keyboard");
       destroy_uinput_keyboard(uinput_fd);
+
+#if defined(ENABLE_STATISTICS)
+      print_statistics(*stage, client.mapping_sources());
+#endif
+
+      if (!settings.profile_file_path.empty() &&
+          !save_profile(settings.profile_file_path, *stage))
+        error("Writing profile '%s' failed",
+          settings.profile_file_path.c_str());
     }
     client.disconnect();
+    metrics_server.set_client_uid(0);
+    if (g_shutdown)
+      return 0;
+    if (g_dump_requested) {
+      g_dump_requested = 0;
+      flight_recorder.dump(stderr, "requested", client.mapping_sources());
+    }
     verbose("---------------");
   }
 }
@@ -1,6 +1,7 @@
 
 #include "uinput_keyboard.h"
 #include "runtime/KeyEvent.h"
+#include "runtime/trace.h"
 #include <algorithm>
 #include <cstring>
 #include <cerrno>
@@ -102,6 +103,7 @@ bool send_key_event(int fd, const KeyEvent& event) {
 }
 
 bool flush_events(int fd) {
+  TRACE(flush_events);
   return send_event(fd, EV_SYN, SYN_REPORT, 0);
 }
 
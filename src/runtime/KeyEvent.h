@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -51,6 +52,27 @@ public:
   }
 };
 
+// a key sequence in contiguous storage, which is owned elsewhere
+class KeySequenceView {
+public:
+  KeySequenceView() = default;
+  KeySequenceView(const KeyEvent* data, size_t size)
+    : m_data(data), m_size(size) {
+  }
+  KeySequenceView(const KeySequence& sequence)
+    : m_data(sequence.data()), m_size(sequence.size()) {
+  }
+  const KeyEvent* begin() const { return m_data; }
+  const KeyEvent* end() const { return m_data + m_size; }
+  size_t size() const { return m_size; }
+  bool empty() const { return (m_size == 0); }
+  const KeyEvent& operator[](size_t index) const { return m_data[index]; }
+
+private:
+  const KeyEvent* m_data{ };
+  size_t m_size{ };
+};
+
 inline bool is_virtual_key(KeyCode key) {
   return (key >= first_virtual_key && key < first_action_key);
 }
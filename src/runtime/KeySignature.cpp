@@ -0,0 +1,87 @@
+
+#include "KeySignature.h"
+#include <cassert>
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+# define KEY_SIGNATURE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define KEY_SIGNATURE_SSE2
+#endif
+
+namespace {
+  void add_key(KeySignature& signature, KeyCode key) {
+    // spread virtual keys, which only differ in the low bits, too
+    const auto hash = static_cast<uint8_t>(key ^ (key >> 8) ^ (key >> 4));
+    signature.bits[hash >> 6] |= (uint64_t{ 1 } << (hash & 63));
+  }
+} // namespace
+
+KeySignature get_expression_signature(KeySequenceView expression) {
+  auto signature = KeySignature{ };
+  for (const auto& event : expression) {
+    if (event.state == KeyState::Not)
+      continue;
+    if (event.key == any_key)
+      return KeySignature{ { ~uint64_t{ }, ~uint64_t{ }, ~uint64_t{ }, ~uint64_t{ } } };
+    add_key(signature, event.key);
+  }
+  return signature;
+}
+
+KeySignature get_sequence_signature(const KeySequence& sequence) {
+  // already matched events are skipped by the matcher
+  auto signature = KeySignature{ };
+  for (const auto& event : sequence)
+    if (event.state == KeyState::Up || event.state == KeyState::Down)
+      add_key(signature, event.key);
+  return signature;
+}
+
+uint64_t filter_signatures(const KeySignature* signatures, size_t count,
+    const KeySignature& sequence) {
+  assert(count <= max_filter_signatures);
+  auto mask = uint64_t{ };
+
+#if defined(KEY_SIGNATURE_AVX2)
+  const auto s = _mm256_load_si256(
+    reinterpret_cast<const __m256i*>(sequence.bits));
+  for (auto i = size_t{ }; i < count; ++i) {
+    const auto e = _mm256_load_si256(
+      reinterpret_cast<const __m256i*>(signatures[i].bits));
+    // (~e & s) == 0
+    mask |= (static_cast<uint64_t>(_mm256_testc_si256(e, s)) << i);
+  }
+
+#elif defined(KEY_SIGNATURE_SSE2)
+  const auto s0 = _mm_load_si128(
+    reinterpret_cast<const __m128i*>(sequence.bits));
+  const auto s1 = _mm_load_si128(
+    reinterpret_cast<const __m128i*>(sequence.bits + 2));
+  const auto zero = _mm_setzero_si128();
+  for (auto i = size_t{ }; i < count; ++i) {
+    const auto e0 = _mm_load_si128(
+      reinterpret_cast<const __m128i*>(signatures[i].bits));
+    const auto e1 = _mm_load_si128(
+      reinterpret_cast<const __m128i*>(signatures[i].bits + 2));
+    const auto missing = _mm_or_si128(
+      _mm_andnot_si128(e0, s0), _mm_andnot_si128(e1, s1));
+    const auto none_missing =
+      (_mm_movemask_epi8(_mm_cmpeq_epi8(missing, zero)) == 0xFFFF);
+    mask |= (static_cast<uint64_t>(none_missing) << i);
+  }
+
+#else
+  for (auto i = size_t{ }; i < count; ++i) {
+    const auto& e = signatures[i].bits;
+    const auto& s = sequence.bits;
+    const auto missing = ((s[0] & ~e[0]) | (s[1] & ~e[1]) |
+                          (s[2] & ~e[2]) | (s[3] & ~e[3]));
+    mask |= (static_cast<uint64_t>(missing == 0) << i);
+  }
+#endif
+
+  return mask;
+}
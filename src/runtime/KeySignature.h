@@ -0,0 +1,22 @@
+#pragma once
+
+#include "KeyEvent.h"
+
+// A bitmask over a hashed key space. A sequence can only match or might
+// match an expression, when each of its pressed or released keys is one
+// of the expression's keys. So an expression can be skipped, when its
+// signature does not contain the signature of the sequence.
+struct alignas(32) KeySignature {
+  uint64_t bits[4];
+};
+
+// maximum number of signatures passed to filter_signatures
+const auto max_filter_signatures = size_t{ 64 };
+
+KeySignature get_expression_signature(KeySequenceView expression);
+KeySignature get_sequence_signature(const KeySequence& sequence);
+
+// returns a mask with a bit set for each signature containing the
+// sequence's signature
+uint64_t filter_signatures(const KeySignature* signatures, size_t count,
+  const KeySignature& sequence);
@@ -29,7 +29,7 @@ namespace {
 
 } // namespace
 
-MatchResult MatchKeySequence::operator()(const KeySequence& expression,
+MatchResult MatchKeySequence::operator()(KeySequenceView expression,
     const KeySequence& sequence) {
   assert(!expression.empty() && !sequence.empty());
 
@@ -37,8 +37,14 @@ MatchResult MatchKeySequence::operator()(const KeySequence& expression,
   auto e = 0u;
   auto s = 0u;
   m_async.clear();
+#if defined(ENABLE_STATISTICS)
+  m_steps = 0;
+#endif
 
   while (e < expression.size() || s < sequence.size()) {
+#if defined(ENABLE_STATISTICS)
+    ++m_steps;
+#endif
     const auto& se = (s < sequence.size() ? sequence[s] : matches_none);
     const auto& ee = (e < expression.size() ? expression[e] : matches_none);
     const auto async_state =
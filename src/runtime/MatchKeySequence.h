@@ -6,10 +6,19 @@ enum class MatchResult { no_match, might_match, match };
 
 class MatchKeySequence {
 public:
-  MatchResult operator()(const KeySequence& expression,
+  MatchResult operator()(KeySequenceView expression,
     const KeySequence& sequence);
 
+#if defined(ENABLE_STATISTICS)
+  // number of steps of the last match
+  int steps() const { return m_steps; }
+#endif
+
 private:
+#if defined(ENABLE_STATISTICS)
+  int m_steps{ };
+#endif
+
   // temporary buffer
   std::vector<KeyEvent> m_async;
 };
@@ -1,10 +1,27 @@
 
 #include "Stage.h"
+#include "trace.h"
 #include <cassert>
 #include <algorithm>
 #include <iterator>
+#include <numeric>
 
 namespace {
+  // number of mappings per block of the output tables
+  const auto output_block_size = size_t{ 64 };
+
+  size_t count_trailing_zeros(uint64_t value) {
+    assert(value);
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_ctzll(value));
+#else
+    auto count = size_t{ };
+    for (; !(value & 1); value >>= 1)
+      ++count;
+    return count;
+#endif
+  }
+
   KeySequence::const_iterator find_key(const KeySequence& sequence, KeyCode key) {
     return std::find_if(begin(sequence), end(sequence),
       [&](const auto& ev) { return ev.key == key; });
@@ -29,11 +46,49 @@ namespace {
         return (e.state == KeyState::Up || e.state == KeyState::Down);
       }) != end(sequence);
   }
-} // namespace
 
-bool operator<(const MappingOverride& a, int mapping_index) {
-  return (a.mapping_index < mapping_index);
-}
+  // a sequence can only match an expression, when each of its pressed or
+  // released keys unifies with one of the expression's (non-Not) keys
+  std::vector<KeyCode> get_matching_keys(const KeySequence& expression) {
+    auto keys = std::vector<KeyCode>();
+    for (const auto& event : expression)
+      if (event.state != KeyState::Not)
+        keys.push_back(event.key);
+    std::sort(begin(keys), end(keys));
+    keys.erase(std::unique(begin(keys), end(keys)), end(keys));
+    return keys;
+  }
+
+  // when no sequence can match both, the order of two mappings is irrelevant
+  bool can_never_both_match(const std::vector<KeyCode>& a,
+                            const std::vector<KeyCode>& b) {
+    if (contains(begin(a), end(a), KeyCode{ any_key }) ||
+        contains(begin(b), end(b), KeyCode{ any_key }))
+      return false;
+    for (auto ia = begin(a), ib = begin(b); ia != end(a) && ib != end(b); ) {
+      if (*ia == *ib)
+        return false;
+      if (*ia < *ib)
+        ++ia;
+      else
+        ++ib;
+    }
+    return true;
+  }
+
+  // keys which appear in no input expression, empty when one contains Any
+  std::vector<bool> get_passthrough_keys(const std::vector<Mapping>& mappings) {
+    auto passthrough_keys = std::vector<bool>(any_key, true);
+    for (const auto& mapping : mappings)
+      for (const auto& event : mapping.input) {
+        if (event.key == any_key)
+          return { };
+        if (event.key < any_key)
+          passthrough_keys[event.key] = false;
+      }
+    return passthrough_keys;
+  }
+} // namespace
 
 bool operator<(const MappingOverride& a, const MappingOverride& b) {
   return (a.mapping_index < b.mapping_index);
@@ -42,7 +97,90 @@ bool operator<(const MappingOverride& a, const MappingOverride& b) {
 Stage::Stage(std::vector<Mapping> mappings,
              std::vector<MappingOverrideSet> override_sets)
   : m_mappings(std::move(mappings)),
-    m_override_sets(sort(std::move(override_sets))) {
+    m_override_sets(sort(std::move(override_sets))),
+    m_passthrough_keys(get_passthrough_keys(m_mappings)),
+    m_mapping_order(m_mappings.size()),
+    m_match_counts(m_mappings.size()) {
+  std::iota(begin(m_mapping_order), end(m_mapping_order), 0);
+  build_output_tables();
+  store_inputs();
+#if defined(ENABLE_STATISTICS)
+  m_statistics.resize(m_mappings.size());
+#endif
+}
+
+auto Stage::add_expression(const KeySequence& expression) -> ExpressionRange {
+  const auto offset = m_expressions.size();
+  m_expressions.insert(end(m_expressions), begin(expression), end(expression));
+  return { static_cast<uint32_t>(offset),
+           static_cast<uint32_t>(expression.size()) };
+}
+
+KeySequenceView Stage::get_expression(const ExpressionRange& range) const {
+  return { m_expressions.data() + range.offset, range.length };
+}
+
+void Stage::build_output_tables() {
+  // the first blocks contain the default outputs, each table refers to
+  // them and only gets own blocks, where its context overrides outputs
+  const auto block_count = get_output_block_count();
+  m_output_blocks.resize(block_count * output_block_size);
+  for (auto i = size_t{ }; i < m_mappings.size(); ++i)
+    m_output_blocks[i] = add_expression(m_mappings[i].output);
+
+  m_output_tables.resize((m_override_sets.size() + 1) * block_count);
+  for (auto b = size_t{ }; b < block_count; ++b)
+    m_output_tables[b] = static_cast<uint32_t>(b * output_block_size);
+
+  for (auto i = size_t{ }; i < m_override_sets.size(); ++i) {
+    const auto table = &m_output_tables[(i + 1) * block_count];
+    std::copy(m_output_tables.data(), m_output_tables.data() + block_count,
+      table);
+
+    for (const auto& mapping_override : m_override_sets[i]) {
+      const auto index = static_cast<size_t>(mapping_override.mapping_index);
+      if (mapping_override.mapping_index < 0 || index >= m_mappings.size())
+        continue;
+      const auto block = index / output_block_size;
+      const auto default_offset = block * output_block_size;
+      if (table[block] == default_offset) {
+        const auto offset = m_output_blocks.size();
+        m_output_blocks.resize(offset + output_block_size);
+        std::copy_n(m_output_blocks.begin() +
+          static_cast<std::ptrdiff_t>(default_offset), output_block_size,
+          m_output_blocks.begin() + static_cast<std::ptrdiff_t>(offset));
+        table[block] = static_cast<uint32_t>(offset);
+      }
+      m_output_blocks[table[block] + index % output_block_size] =
+        add_expression(mapping_override.output);
+    }
+  }
+  m_output_table = m_output_tables.data();
+  m_outputs_size = m_expressions.size();
+}
+
+void Stage::store_inputs() {
+  // store inputs in the order they are matched
+  m_expressions.resize(m_outputs_size);
+  m_ordered_inputs.clear();
+  for (auto index : m_mapping_order)
+    m_ordered_inputs.push_back(
+      add_expression(m_mappings[static_cast<size_t>(index)].input));
+  m_expressions.shrink_to_fit();
+
+  m_ordered_signatures.clear();
+  for (const auto& input : m_ordered_inputs)
+    m_ordered_signatures.push_back(
+      get_expression_signature(get_expression(input)));
+}
+
+size_t Stage::get_output_block_count() const {
+  return (m_mappings.size() + output_block_size - 1) / output_block_size;
+}
+
+size_t Stage::output_tables_size() const {
+  return m_output_blocks.size() * sizeof(m_output_blocks[0]) +
+         m_output_tables.size() * sizeof(m_output_tables[0]);
 }
 
 const std::vector<Mapping>& Stage::mappings() const {
@@ -53,10 +191,35 @@ const std::vector<MappingOverrideSet>& Stage::override_sets() const {
   return m_override_sets;
 }
 
+void Stage::reorder_mappings(std::vector<uint32_t> match_counts) {
+  if (match_counts.size() != m_mappings.size())
+    return;
+  m_match_counts = std::move(match_counts);
+
+  auto keys = std::vector<std::vector<KeyCode>>();
+  for (const auto& mapping : m_mappings)
+    keys.push_back(get_matching_keys(mapping.input));
+
+  // move frequently matching mappings to the front, but never past
+  // a mapping which could match the same sequence
+  std::iota(begin(m_mapping_order), end(m_mapping_order), 0);
+  for (auto i = size_t{ 1 }; i < m_mapping_order.size(); ++i)
+    for (auto j = i; j > 0; --j) {
+      const auto a = static_cast<size_t>(m_mapping_order[j - 1]);
+      const auto b = static_cast<size_t>(m_mapping_order[j]);
+      if (m_match_counts[a] >= m_match_counts[b] ||
+          !can_never_both_match(keys[a], keys[b]))
+        break;
+      std::swap(m_mapping_order[j - 1], m_mapping_order[j]);
+    }
+  store_inputs();
+}
+
 void Stage::activate_override_set(int index) {
-  m_active_override_set = (index < 0 || index >=
-    static_cast<int>(m_override_sets.size()) ?
-    nullptr : &m_override_sets[static_cast<size_t>(index)]);
+  const auto table = (index < 0 || index >=
+    static_cast<int>(m_override_sets.size()) ? 0 : index + 1);
+  m_output_table = m_output_tables.data() +
+    static_cast<size_t>(table) * get_output_block_count();
 }
 
 void Stage::reuse_buffer(KeySequence&& buffer) {
@@ -83,8 +246,50 @@ void Stage::validate_state(const std::function<bool(KeyCode)>& is_down) {
 }
 
 KeySequence Stage::apply_input(const KeyEvent event) {
+  process_input(event);
+  return std::move(m_output_buffer);
+}
+
+KeySequence Stage::apply_inputs(const KeyEvent* events, size_t count) {
+  // each event changes the sequence, so matching is done per event,
+  // only the output buffer is shared
+  const auto is_output_on_release = [](const KeyEvent& event) {
+    return event.state == KeyState::OutputOnRelease;
+  };
+  auto last_matched_mapping = -1;
+  auto output_on_release = false;
+  for (auto i = size_t{ }; i < count; ++i) {
+    // output after OutputOnRelease is sent before the next input is applied
+    if (output_on_release)
+      m_output_buffer.erase(
+        std::remove_if(begin(m_output_buffer), end(m_output_buffer),
+          is_output_on_release),
+        end(m_output_buffer));
+
+    const auto output_size = m_output_buffer.size();
+    process_input(events[i]);
+    output_on_release = std::any_of(
+      std::next(begin(m_output_buffer), static_cast<ptrdiff_t>(output_size)),
+      end(m_output_buffer), is_output_on_release);
+    if (m_last_matched_mapping >= 0)
+      last_matched_mapping = m_last_matched_mapping;
+  }
+  m_last_matched_mapping = last_matched_mapping;
+  return std::move(m_output_buffer);
+}
+
+void Stage::process_input(const KeyEvent& event) {
   assert(event.state == KeyState::Down ||
          event.state == KeyState::Up);
+  TRACE2(apply_input_begin, event.key, static_cast<int>(event.state));
+
+  // when the sequence only contains matched keys, keys which no mapping
+  // contains can not lead to a match and are forwarded immediately
+  if (!m_sequence_might_match && is_passthrough_key(event.key)) {
+    apply_passthrough_input(event);
+    TRACE1(apply_input_end, m_last_matched_mapping);
+    return;
+  }
 
   if (event.state == KeyState::Down) {
     // merge key repeats
@@ -116,32 +321,83 @@ KeySequence Stage::apply_input(const KeyEvent event) {
     output.suppressed = false;
 
   m_sequence_might_match = false;
+  m_last_matched_mapping = -1;
   while (has_non_optional(m_sequence)) {
-    // find first mapping which matches or might match sequence
-    for (const auto& mapping : m_mappings) {
-      const auto result = m_match(mapping.input, m_sequence);
-
-      if (result == MatchResult::might_match) {
-        // hold back sequence when something might match
-        m_sequence_might_match = true;
-        return std::move(m_output_buffer);
-      }
+    // find first mapping which matches or might match sequence,
+    // skipping those which can not contain its keys
+    const auto signature = get_sequence_signature(m_sequence);
+    for (auto first = size_t{ }; first < m_mapping_order.size();
+         first += max_filter_signatures) {
+      const auto count = std::min(max_filter_signatures,
+        m_mapping_order.size() - first);
+      for (auto candidates = filter_signatures(&m_ordered_signatures[first],
+             count, signature); candidates; candidates &= candidates - 1) {
+        const auto i = first + count_trailing_zeros(candidates);
+        const auto index = m_mapping_order[i];
+        const auto result = m_match(get_expression(m_ordered_inputs[i]),
+          m_sequence);
+
+#if defined(ENABLE_STATISTICS)
+        auto& statistics = m_statistics[static_cast<size_t>(index)];
+        ++statistics.tested;
+        statistics.matcher_steps += static_cast<uint64_t>(m_match.steps());
+        if (result == MatchResult::match)
+          ++statistics.matched;
+        else if (result == MatchResult::might_match)
+          ++statistics.might_matched;
+#endif
+
+        if (result == MatchResult::might_match) {
+          // hold back sequence when something might match
+          m_sequence_might_match = true;
+          TRACE2(might_match, index, m_sequence.size());
+          TRACE1(apply_input_end, m_last_matched_mapping);
+          return;
+        }
 
-      if (result == MatchResult::match) {
-        apply_output(get_output(mapping));
+        if (result == MatchResult::match) {
+          ++m_match_counts[static_cast<size_t>(index)];
+          m_last_matched_mapping = index;
+          apply_output(get_output(index));
 
-        // release new output when triggering input was released
-        if (event.state == KeyState::Up)
-          release_triggered(event.key);
+          // release new output when triggering input was released
+          if (event.state == KeyState::Up)
+            release_triggered(event.key);
 
-        finish_sequence();
-        return std::move(m_output_buffer);
+          finish_sequence();
+          TRACE1(apply_input_end, m_last_matched_mapping);
+          return;
+        }
       }
     }
     // when no match was found, forward beginning of sequence
     forward_from_sequence();
   }
-  return std::move(m_output_buffer);
+  TRACE1(apply_input_end, m_last_matched_mapping);
+}
+
+bool Stage::is_passthrough_key(KeyCode key) const {
+  return (key < m_passthrough_keys.size() && m_passthrough_keys[key]);
+}
+
+void Stage::apply_passthrough_input(const KeyEvent& event) {
+  // same result as matching and forward_from_sequence, a pressed key
+  // is moved to the end of the sequence
+  m_last_matched_mapping = -1;
+  const auto it = find_key(m_sequence, event.key);
+  if (it != end(m_sequence))
+    m_sequence.erase(it);
+
+  if (event.state == KeyState::Up)
+    release_triggered(event.key);
+
+  for (auto& output : m_output_down)
+    output.suppressed = false;
+
+  if (event.state == KeyState::Down) {
+    m_sequence.emplace_back(event.key, KeyState::DownMatched);
+    update_output(event, event.key);
+  }
 }
 
 void Stage::release_triggered(KeyCode key) {
@@ -157,16 +413,10 @@ void Stage::release_triggered(KeyCode key) {
   m_output_down.erase(it, end(m_output_down));
 }
 
-const KeySequence& Stage::get_output(const Mapping& mapping) const {
-  // look for override
-  if (m_active_override_set) {
-    const auto& override_set = *m_active_override_set;
-    const auto index = static_cast<int>(std::distance(m_mappings.data(), &mapping));
-    auto it = std::lower_bound(begin(override_set), end(override_set), index);
-    if (it != end(override_set) && it->mapping_index == index)
-      return it->output;
-  }
-  return mapping.output;
+KeySequenceView Stage::get_output(int mapping_index) const {
+  const auto index = static_cast<size_t>(mapping_index);
+  return get_expression(m_output_blocks[
+    m_output_table[index / output_block_size] + index % output_block_size]);
 }
 
 void Stage::toggle_virtual_key(KeyCode key) {
@@ -177,15 +427,16 @@ void Stage::toggle_virtual_key(KeyCode key) {
     m_sequence.emplace_back(key, KeyState::Down);
 }
 
-void Stage::output_current_sequence(const KeySequence& expression, KeyCode trigger) {
+void Stage::output_current_sequence(KeySequenceView expression, KeyCode trigger) {
   for (const auto& event : m_sequence) {
-    const auto it = find_key(expression, event.key);
+    const auto it = std::find_if(expression.begin(), expression.end(),
+      [&](const KeyEvent& e) { return e.key == event.key; });
     if (it == expression.end() || it->state != KeyState::Not)
       update_output(event, trigger);
   }
 }
 
-void Stage::apply_output(const KeySequence& expression) {
+void Stage::apply_output(KeySequenceView expression) {
   for (const auto& event : expression)
     if (is_virtual_key(event.key)) {
       if (event.state == KeyState::Down)
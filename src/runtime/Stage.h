@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MatchKeySequence.h"
+#include "KeySignature.h"
 #include <functional>
 
 struct Mapping {
@@ -14,39 +15,96 @@ struct MappingOverride {
 };
 using MappingOverrideSet = std::vector<MappingOverride>;
 
+#if defined(ENABLE_STATISTICS)
+struct MappingStatistics {
+  uint64_t tested;
+  uint64_t matched;
+  uint64_t might_matched;
+  uint64_t matcher_steps;
+};
+#endif
+
 class Stage {
 public:
   Stage(std::vector<Mapping> mappings,
         std::vector<MappingOverrideSet> override_sets);
 
   bool is_output_down() const { return !m_output_down.empty(); }
+  bool is_sequence_held_back() const { return m_sequence_might_match; }
+  int last_matched_mapping() const { return m_last_matched_mapping; }
   const std::vector<Mapping>& mappings() const;
   const std::vector<MappingOverrideSet>& override_sets() const;
+  size_t output_tables_size() const;
+  const std::vector<uint32_t>& match_counts() const { return m_match_counts; }
+  const std::vector<int>& mapping_order() const { return m_mapping_order; }
+  void reorder_mappings(std::vector<uint32_t> match_counts);
+#if defined(ENABLE_STATISTICS)
+  const std::vector<MappingStatistics>& statistics() const { return m_statistics; }
+#endif
   const KeySequence& sequence() const { return m_sequence; }
   void activate_override_set(int index);
   KeySequence apply_input(KeyEvent event);
+  KeySequence apply_inputs(const KeyEvent* events, size_t count);
   void reuse_buffer(KeySequence&& buffer);
   void validate_state(const std::function<bool(KeyCode)>& is_down);
 
 private:
+  void process_input(const KeyEvent& event);
+  bool is_passthrough_key(KeyCode key) const;
+  void apply_passthrough_input(const KeyEvent& event);
   void release_triggered(KeyCode key);
-  const KeySequence& get_output(const Mapping& mapping) const;
+  struct ExpressionRange {
+    uint32_t offset;
+    uint32_t length;
+  };
+  ExpressionRange add_expression(const KeySequence& expression);
+  KeySequenceView get_expression(const ExpressionRange& range) const;
+  void build_output_tables();
+  void store_inputs();
+  size_t get_output_block_count() const;
+  KeySequenceView get_output(int mapping_index) const;
   void forward_from_sequence();
-  void apply_output(const KeySequence& expression);
+  void apply_output(KeySequenceView expression);
   void update_output(const KeyEvent& event, KeyCode trigger);
   void finish_sequence();
   void toggle_virtual_key(KeyCode key);
-  void output_current_sequence(const KeySequence& expression, KeyCode trigger);
+  void output_current_sequence(KeySequenceView expression, KeyCode trigger);
 
   const std::vector<Mapping> m_mappings;
   const std::vector<MappingOverrideSet> m_override_sets;
 
+  // keys which appear in no input expression, when none contains Any
+  std::vector<bool> m_passthrough_keys;
+
+  // the input and output expressions of all mappings in contiguous
+  // storage, first the outputs, followed by the inputs in matching order.
+  // Keys and states are not split into parallel arrays, a KeyEvent has
+  // only four bytes and the matcher always reads both of them.
+  std::vector<KeyEvent> m_expressions;
+  size_t m_outputs_size{ };
+
+  // order in which mappings are matched, their inputs and signatures in
+  // the same order and how often each one matched
+  std::vector<int> m_mapping_order;
+  std::vector<ExpressionRange> m_ordered_inputs;
+  std::vector<KeySignature> m_ordered_signatures;
+  std::vector<uint32_t> m_match_counts;
+#if defined(ENABLE_STATISTICS)
+  std::vector<MappingStatistics> m_statistics;
+#endif
+
   MatchKeySequence m_match;
-  const MappingOverrideSet* m_active_override_set{ };
+
+  // output of each mapping per context, in blocks of mappings which are
+  // shared with the default outputs when a context overrides none of them
+  std::vector<ExpressionRange> m_output_blocks;
+  std::vector<uint32_t> m_output_tables;
+  const uint32_t* m_output_table{ };
 
   // the input since the last match (or already matched but still hold)
   KeySequence m_sequence;
   bool m_sequence_might_match{ };
+  int m_last_matched_mapping{ -1 };
 
   // the keys which were output and are still down
   struct OutputDown {
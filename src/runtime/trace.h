@@ -0,0 +1,18 @@
+#pragma once
+
+// Statically defined tracepoints (USDT) for tracing with eBPF tools like
+// bpftrace. They are only a nop instruction until a tracer attaches and are
+// available when compiled with <sys/sdt.h> (e.g. systemtap-sdt-dev).
+#if defined(__linux__) && __has_include(<sys/sdt.h>) && \
+    !defined(DISABLE_TRACEPOINTS)
+# include <sys/sdt.h>
+# define TRACE(name) DTRACE_PROBE(keymapper, name)
+# define TRACE1(name, a) DTRACE_PROBE1(keymapper, name, a)
+# define TRACE2(name, a, b) DTRACE_PROBE2(keymapper, name, a, b)
+# define TRACE4(name, a, b, c, d) DTRACE_PROBE4(keymapper, name, a, b, c, d)
+#else
+# define TRACE(name) ((void)0)
+# define TRACE1(name, a) ((void)0)
+# define TRACE2(name, a, b) ((void)0)
+# define TRACE4(name, a, b, c, d) ((void)0)
+#endif
@@ -0,0 +1,153 @@
+
+// libFuzzer target, which parses the input up to the first null byte as
+// configuration and uses the following bytes to press and release keys.
+// A byte with the lower bits 0x7F activates the context selected by the
+// byte following it.
+// Inputs which make a single apply_input exceed the time budget or let the
+// sequence grow beyond the pressed keys are reported as crashes.
+//   KEYMAPPER_FUZZ_BUDGET_US  time budget per event (default 1000)
+
+#include "config/ParseConfig.h"
+#include "config/CreateStage.h"
+#include "config/string_iteration.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  const auto max_config_size = size_t{ 4096 };
+  const auto max_events = size_t{ 4096 };
+  const auto max_keys = size_t{ 16 };
+  const auto context_marker = uint8_t{ 0x7F };
+
+  const auto time_budget = std::chrono::microseconds(
+    std::getenv("KEYMAPPER_FUZZ_BUDGET_US") ?
+    std::atoi(std::getenv("KEYMAPPER_FUZZ_BUDGET_US")) : 1000);
+
+  template<typename... Args>
+  [[noreturn]] void report(const char* format, Args... args) {
+    std::fprintf(stderr, format, args...);
+    std::fprintf(stderr, "\n");
+    std::abort();
+  }
+
+  void add_key(std::vector<KeyCode>& keys, KeyCode key) {
+    if (key != no_key && key != any_key && !is_virtual_key(key) &&
+        !is_action_key(key) && keys.size() < max_keys &&
+        std::find(keys.begin(), keys.end(), key) == keys.end())
+      keys.push_back(key);
+  }
+
+  void add_virtual_keys(std::vector<KeyCode>& virtual_keys,
+      const KeySequence& sequence) {
+    for (const auto& event : sequence)
+      if (is_virtual_key(event.key) &&
+          std::find(virtual_keys.begin(), virtual_keys.end(),
+            event.key) == virtual_keys.end())
+        virtual_keys.push_back(event.key);
+  }
+
+  // include directives would read files
+  bool has_include_directive(std::string_view text) {
+    for (auto it = text.begin(); it != text.end(); ) {
+      const auto line_end = std::find(it, text.end(), '\n');
+      skip_space_and_comments(&it, line_end);
+      const auto begin = it;
+      skip_ident(&it, line_end);
+      if (to_string_view(begin, it) == "include")
+        return true;
+      it = (line_end == text.end() ? line_end : std::next(line_end));
+    }
+    return false;
+  }
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  const auto begin = reinterpret_cast<const char*>(data);
+  const auto end = std::find(begin, begin + size, '\0');
+  const auto text = std::string_view(begin,
+    static_cast<size_t>(end - begin));
+  if (text.size() > max_config_size || has_include_directive(text))
+    return -1;
+
+  auto config = Config{ };
+  try {
+    auto parse_config = ParseConfig();
+    config = parse_config(text);
+  }
+  catch (const std::exception&) {
+    return 0;
+  }
+
+  // press keys which appear in input expressions
+  auto keys = std::vector<KeyCode>();
+  auto virtual_keys = std::vector<KeyCode>();
+  auto max_input_length = size_t{ };
+  for (const auto& command : config.commands) {
+    max_input_length = std::max(max_input_length, command.input.size());
+    for (const auto& event : command.input)
+      add_key(keys, event.key);
+    add_virtual_keys(virtual_keys, command.default_mapping);
+    for (const auto& context_mapping : command.context_mappings)
+      add_virtual_keys(virtual_keys, context_mapping.output);
+  }
+  add_key(keys, 0x001E); // A
+  const auto stage = create_stage(config);
+  const auto contexts = config.contexts.size();
+
+  // besides the expression which might match, the sequence only
+  // contains keys which are still hold and the toggled virtual keys
+  const auto max_sequence_length =
+    max_input_length + 2 * keys.size() + virtual_keys.size();
+
+  auto pressed = std::vector<bool>(keys.size());
+  const auto events = std::min(size_t{ static_cast<size_t>(
+    begin + size - end) }, max_events);
+  for (auto i = size_t{ 1 }; i < events; ++i) {
+    if ((static_cast<uint8_t>(end[i]) & 0x7F) == context_marker) {
+      // select one of the contexts or none
+      if (++i < events)
+        stage->activate_override_set(static_cast<int>(
+          static_cast<uint8_t>(end[i]) % (contexts + 1)) - 1);
+      continue;
+    }
+
+    const auto index = (static_cast<uint8_t>(end[i]) & 0x7F) % keys.size();
+    // highest bit repeats a pressed key instead of releasing it
+    const auto repeat = ((static_cast<uint8_t>(end[i]) & 0x80) != 0);
+    const auto down = (!pressed[index] || repeat);
+    pressed[index] = down;
+
+    const auto start = Clock::now();
+    stage->apply_input({ keys[index], down ? KeyState::Down : KeyState::Up });
+    const auto duration = Clock::now() - start;
+
+    if (duration > time_budget)
+      report("apply_input took %lld us",
+        static_cast<long long>(std::chrono::duration_cast<
+          std::chrono::microseconds>(duration).count()));
+
+    if (stage->sequence().size() > max_sequence_length)
+      report("sequence grew to %zu events", stage->sequence().size());
+  }
+  return 0;
+}
+
+#if !defined(__clang__)
+// minimal driver for compilers without libFuzzer, runs the passed inputs
+#include <fstream>
+#include <iterator>
+
+int main(int argc, char* argv[]) {
+  for (auto i = 1; i < argc; ++i) {
+    auto file = std::ifstream(argv[i], std::ios::binary);
+    const auto input = std::string(std::istreambuf_iterator<char>(file), { });
+    LLVMFuzzerTestOneInput(
+      reinterpret_cast<const uint8_t*>(input.data()), input.size());
+  }
+}
+#endif
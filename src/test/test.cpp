@@ -7,39 +7,6 @@
 #include "config/string_iteration.h"
 #include "config/Key.h"
 
-namespace {
-  std::ostream& operator<<(std::ostream& os, const KeyEvent& event) {
-    switch (event.state) {
-      case KeyState::Up: os << '-'; break;
-      case KeyState::Down: os << '+'; break;
-      case KeyState::UpAsync: os << '~'; break;
-      case KeyState::DownAsync: os << '*'; break;
-      case KeyState::Not: os << '!'; break;
-      case KeyState::DownMatched: os << '#'; break;
-      case KeyState::OutputOnRelease: os << '^'; break;
-    }
-    if (!is_action_key(event.key)) {
-      os << get_key_name(static_cast<Key>(event.key));
-    }
-    else {
-      os << "Action" << (event.key - first_action_key);
-    }
-    return os;
-  }
-
-  struct Stream : std::stringstream {
-    bool first = true;
-
-    template<typename T>
-    Stream& operator<<(const T& v) {
-      if (!std::exchange(first, false))
-        static_cast<std::ostream&>(*this) << ' ';
-      static_cast<std::ostream&>(*this) << v;
-      return *this;
-    }
-  };
-} // namespace
-
 KeySequence parse_input(const char* input) {
   static auto parse = ParseKeySequence();
   return parse(input, true);
@@ -70,8 +37,5 @@ KeySequence parse_sequence(const char* it, const char* const end) {
 }
 
 std::string format_sequence(const KeySequence& sequence) {
-  auto stream = Stream();
-  for (const auto& event : sequence)
-    stream << event;
-  return stream.str();
+  return format_key_sequence(sequence);
 }
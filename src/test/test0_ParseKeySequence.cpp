@@ -237,3 +237,31 @@ TEST_CASE("Output Expression", "[ParseKeySequence]") {
 }
 
 //--------------------------------------------------------------------
+
+TEST_CASE("Key names", "[ParseKeySequence]") {
+  auto count = 0;
+  for (auto key_code = 0; key_code <= 0xFFFF; ++key_code) {
+    const auto key = static_cast<Key>(key_code);
+    const auto name = get_key_name(key);
+    if (!name.empty()) {
+      ++count;
+      CHECK(get_key_by_name(name) == key);
+    }
+  }
+  CHECK(count > 150);
+  CHECK(get_key_name(Key::None).empty());
+  CHECK(get_key_name(Key::ShiftLeft) == "ShiftLeft");
+  CHECK(get_key_name(Key::Virtual9) == "Virtual9");
+  CHECK(get_key_by_name("A") == Key::A);
+  CHECK(get_key_by_name("KeyA") == Key::A);
+  CHECK(get_key_by_name("Digit1") == Key::Digit1);
+  CHECK(get_key_by_name("1") == Key::Digit1);
+  CHECK(get_key_by_name("Any") == Key::Any);
+  CHECK(get_key_by_name("") == Key::None);
+  CHECK(get_key_by_name("None") == Key::None);
+  CHECK(get_key_by_name("Key") == Key::None);
+  CHECK(get_key_by_name("a") == Key::None);
+  CHECK(get_key_by_name("ShiftLeftX") == Key::None);
+}
+
+//--------------------------------------------------------------------
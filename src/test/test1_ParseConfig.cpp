@@ -1,6 +1,11 @@
 
 #include "test.h"
 #include "config/ParseConfig.h"
+#include "config/FindContext.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 
 namespace {
   Config parse_config(const char* config) {
@@ -8,6 +13,27 @@ namespace {
     auto stream = std::stringstream(config);
     return parse(stream, false);
   }
+
+  std::string write_file(const std::string& filename, const char* contents) {
+    const auto path = (std::filesystem::temp_directory_path() /
+      "keymapper_test" / filename);
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path) << contents;
+    return path.string();
+  }
+
+  std::string get_error(ParseConfig& parse, const std::string& filename) {
+    auto is = std::ifstream(filename);
+    const auto text = std::string(std::istreambuf_iterator<char>(is),
+                                  std::istreambuf_iterator<char>());
+    try {
+      parse(std::string_view(text), false, filename);
+    }
+    catch (const ParseError& error) {
+      return error.what();
+    }
+    return { };
+  }
 } // namespace
 
 //--------------------------------------------------------------------
@@ -374,3 +400,197 @@ TEST_CASE("Terminal command", "[ParseConfig]") {
 
 //--------------------------------------------------------------------
 
+TEST_CASE("Find context", "[ParseConfig]") {
+  auto string = R"(
+    A >> command
+
+    [class = "Class1" title = "Title1"]
+    command >> B
+
+    [title = /Title[12]/]
+    command >> C
+
+    [class = "Class1"]
+    command >> D
+
+    [class = /Class[23]/ title = "Title3"]
+    command >> E
+
+    [class = "Class2"]
+    command >> F
+
+    [class = "Class1" title = "Title4"]
+    command >> G
+
+    [title = "Title"]
+    command >> H
+  )";
+  auto config = parse_config(string);
+  auto find = FindContext(config);
+
+  const auto classes = { "Class1", "Class2", "Class3", "Class4", "" };
+  const auto titles = { "Title1", "Title2", "Title3", "Title4", "Some", "" };
+
+  // results of indexed and cached lookup match linear lookup
+  for (auto i = 0; i < 2; ++i)
+    for (auto window_class : classes)
+      for (auto window_title : titles) {
+        CHECK(find(window_class, window_title) ==
+              find_context(config, window_class, window_title));
+        CHECK(find(window_class, window_title) ==
+              find_context(config, window_class, window_title));
+      }
+
+  CHECK(find("Class1", "Title1") == 0);
+  CHECK(find("Class1", "Title2") == 1);
+  CHECK(find("Class1", "Title4") == 2);
+  CHECK(find("Class2", "Title3") == 3);
+  CHECK(find("Class2", "Some") == 4);
+  CHECK(find("Class3", "Title3") == 3);
+  CHECK(find("Class4", "Title4") == 6);
+  CHECK(find("Class4", "Some") == -1);
+  CHECK(FindContext()("Class1", "Title1") == -1);
+}
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Include", "[ParseConfig]") {
+  write_file("base.conf", R"(
+    Macro = A B
+    Macro >> command1
+    C >> command2
+    command1 >> E
+    command2 >> F
+  )");
+  write_file("fragments/context.conf", R"(
+    command1 >> D
+    command2 >> $(ls)
+  )");
+  const auto main = write_file("main.conf", R"(
+    include base.conf # comment
+    [title = "Title"]
+    include "fragments/context.conf"
+  )");
+  auto parse = ParseConfig();
+  const auto parse_file = [&]() {
+    auto is = std::ifstream(main);
+    const auto text = std::string(std::istreambuf_iterator<char>(is),
+                                  std::istreambuf_iterator<char>());
+    return parse(std::string_view(text), false, main);
+  };
+
+  // replaying cached fragments has the same result
+  for (auto i = 0; i < 2; ++i) {
+    const auto config = parse_file();
+    REQUIRE(config.commands.size() == 2);
+    REQUIRE(config.contexts.size() == 1);
+    REQUIRE(config.actions.size() == 1);
+    CHECK(config.actions[0].terminal_command == "ls");
+    CHECK(config.commands[0].input == parse_input("A B"));
+    CHECK(format_sequence(config.commands[0].default_mapping) == "+E");
+    CHECK(format_sequence(config.commands[0].context_mappings[0].output) == "+D");
+    CHECK(format_sequence(config.commands[1].default_mapping) == "+F");
+    CHECK(parse.included_files().size() == 2);
+
+    // location where commands were defined
+    CHECK(config.commands[0].line_no == 3);
+    CHECK(config.commands[1].line_no == 4);
+    CHECK(std::filesystem::path(config.commands[1].filename).filename() == "base.conf");
+  }
+
+  // changed fragment is parsed again
+  write_file("fragments/context.conf", R"(
+    command1 >> G
+    command2 >> H
+  )");
+  auto config = parse_file();
+  REQUIRE(config.commands.size() == 2);
+  CHECK(format_sequence(config.commands[0].context_mappings[0].output) == "+G");
+  CHECK(config.actions.empty());
+
+  // fragment is parsed again, when macro changed
+  write_file("macro.conf", "Macro >> command1\n");
+  const auto macro = write_file("macro_main.conf", "");
+  auto parse_macro = [&](const char* value) {
+    auto text = std::string("Macro = ") + value + "\ninclude macro.conf\ncommand1 >> B";
+    return parse(std::string_view(text), false, macro);
+  };
+  CHECK(parse_macro("A").commands[0].input == parse_input("A"));
+  CHECK(parse_macro("C").commands[0].input == parse_input("C"));
+}
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Include problems", "[ParseConfig]") {
+  auto parse = ParseConfig();
+
+  const auto cycle = write_file("cycle1.conf", "include cycle2.conf");
+  write_file("cycle2.conf", "include cycle1.conf");
+  CHECK(get_error(parse, cycle).find("Recursive include") != std::string::npos);
+
+  const auto missing = write_file("missing.conf", "include none.conf");
+  CHECK(get_error(parse, missing).find("none.conf' failed in line 1") !=
+    std::string::npos);
+
+  // error is reported with line in included file
+  const auto invalid = write_file("invalid.conf", "\n\ninclude invalid2.conf");
+  write_file("invalid2.conf", "A >> B\nA >> C >> D");
+  CHECK(get_error(parse, invalid).find("in line 2 of '") != std::string::npos);
+  CHECK(get_error(parse, invalid).find("invalid2.conf'") != std::string::npos);
+
+  CHECK_THROWS(parse_config("include"));
+  CHECK_THROWS(parse_config("include 'file"));
+  CHECK_THROWS(parse_config("include a.conf b.conf"));
+
+  // lines which continue with '>>' are mappings
+  auto config = parse_config(R"(
+    include = A
+    include B >> C
+    include >> D
+  )");
+  REQUIRE(config.commands.size() == 2);
+  CHECK(config.commands[0].input == parse_input("A B"));
+  CHECK(format_sequence(config.commands[0].default_mapping) == "+C");
+  CHECK(config.commands[1].input == parse_input("A"));
+  CHECK(format_sequence(config.commands[1].default_mapping) == "+D");
+  CHECK_THROWS(parse_config("include B >> C"));
+}
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Parser benchmark", "[.benchmark]") {
+  // generate a configuration with a unique input sequence per command
+  const auto generate_config = [](int commands) {
+    const auto sequence = [](int index) {
+      auto string = std::string();
+      for (auto i = 0; i < 4; ++i, index /= 26)
+        string += std::string(1, static_cast<char>('A' + index % 26)) + " ";
+      return string;
+    };
+    auto string = std::string();
+    for (auto i = 0; i < commands; ++i)
+      string += sequence(i) + ">> command" + std::to_string(i) + "\n";
+    for (auto i = 0; i < commands; ++i)
+      string += "command" + std::to_string(i) + " >> Shift{X}\n";
+    for (auto i = 0; i < commands; ++i) {
+      if (i % 100 == 0)
+        string += "[title = \"Title" + std::to_string(i) + "\"]\n";
+      string += "command" + std::to_string(i) + " >> Y\n";
+      string += sequence(commands + i) + ">> Z\n";
+    }
+    return string;
+  };
+
+  using Clock = std::chrono::high_resolution_clock;
+  for (auto commands = 2500; commands <= 20000; commands *= 2) {
+    const auto text = generate_config(commands);
+    const auto start = Clock::now();
+    const auto config = ParseConfig()(std::string_view(text), false);
+    const auto duration = std::chrono::duration_cast<
+      std::chrono::microseconds>(Clock::now() - start);
+    std::printf("%6d lines %10.3f ms %8.3f us/line\n", commands * 4,
+      static_cast<double>(duration.count()) / 1000,
+      static_cast<double>(duration.count()) / (commands * 4));
+    CHECK(config.commands.size() == static_cast<size_t>(commands * 2));
+  }
+}
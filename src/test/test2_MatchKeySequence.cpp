@@ -1,6 +1,8 @@
 
 #include "test.h"
 #include "runtime/MatchKeySequence.h"
+#include "runtime/KeySignature.h"
+#include <cstring>
 
 namespace  {
   MatchResult match(const KeySequence& expression,
@@ -162,3 +164,58 @@ TEST_CASE("Match ANY", "[MatchKeySequence]") {
 }
 
 //--------------------------------------------------------------------
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Key signatures", "[MatchKeySequence]") {
+  const auto inputs = {
+    "A", "A B", "A{B}", "(A B)", "A{B{C}}", "A{B C}", "!A B", "A !B C",
+    "ShiftLeft{A}", "Any", "Any B", "Any{B}", "Virtual1{A}", "Virtual2 C",
+  };
+  const auto sequences = {
+    "+A", "+B", "+A -A", "+A +B", "+B +A", "+A -A +B", "+A +B +C",
+    "+C", "+ShiftLeft +A", "+ShiftLeft", "+Virtual1", "+Virtual1 +A",
+    "+Virtual2 +C", "+D -D", "+A -A +C",
+  };
+
+  auto expressions = std::vector<KeySequence>();
+  auto signatures = std::vector<KeySignature>();
+  for (auto input : inputs) {
+    expressions.push_back(parse_input(input));
+    signatures.push_back(get_expression_signature(expressions.back()));
+  }
+
+  for (auto string : sequences) {
+    const auto sequence = parse_sequence(string, string + std::strlen(string));
+    const auto candidates = filter_signatures(signatures.data(),
+      signatures.size(), get_sequence_signature(sequence));
+
+    // expressions which are filtered can never match or might match
+    for (auto i = 0u; i < expressions.size(); ++i) {
+      INFO(*(inputs.begin() + i) << " / " << string);
+      if (!(candidates & (uint64_t{ 1 } << i)))
+        CHECK(match(expressions[i], sequence) == MatchResult::no_match);
+      if (match(expressions[i], sequence) != MatchResult::no_match)
+        CHECK(candidates & (uint64_t{ 1 } << i));
+    }
+  }
+
+  const auto filter = [&](const char* input, const char* sequence) {
+    const auto signature = get_expression_signature(parse_input(input));
+    return filter_signatures(&signature, 1, get_sequence_signature(
+      parse_sequence(sequence, sequence + std::strlen(sequence)))) != 0;
+  };
+  CHECK(filter("A B", "+A -A +B"));
+  CHECK(!filter("A B", "+C"));
+  CHECK(!filter("A B", "+A +C"));
+  CHECK(!filter("!A B", "+A"));
+  CHECK(filter("Any B", "+C"));
+  CHECK(filter("Virtual1{A}", "+Virtual1 +A"));
+  CHECK(!filter("Virtual1{A}", "+Virtual2"));
+
+  // already matched keys are ignored
+  auto sequence = parse_sequence("+ShiftLeft +A");
+  sequence[0].state = KeyState::DownMatched;
+  const auto signature = get_expression_signature(parse_input("A"));
+  CHECK(filter_signatures(&signature, 1, get_sequence_signature(sequence)));
+}
@@ -2,6 +2,18 @@
 #include "test.h"
 #include "config/ParseConfig.h"
 #include "runtime/Stage.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#if defined(__linux__)
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
 
 namespace {
   Stage create_stage(const char* string) {
@@ -27,6 +39,57 @@ namespace {
     return Stage(std::move(mappings), std::move(override_sets));
   }
 
+  // counts the cache misses of the calling thread, when perf events are
+  // available (see perf_event_paranoid)
+  class CacheMissCounter {
+  public:
+    CacheMissCounter() {
+#if defined(__linux__)
+      auto attr = perf_event_attr{ };
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      m_fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+    CacheMissCounter(const CacheMissCounter&) = delete;
+    CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+    ~CacheMissCounter() {
+#if defined(__linux__)
+      if (m_fd >= 0)
+        ::close(m_fd);
+#endif
+    }
+    bool available() const { return (m_fd >= 0); }
+
+    void start() {
+#if defined(__linux__)
+      if (m_fd >= 0) {
+        ::ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+    }
+
+    uint64_t stop() {
+      auto count = uint64_t{ };
+#if defined(__linux__)
+      if (m_fd >= 0) {
+        ::ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (::read(m_fd, &count, sizeof(count)) != sizeof(count))
+          count = 0;
+      }
+#endif
+      return count;
+    }
+
+  private:
+    int m_fd{ -1 };
+  };
+
   template<size_t N>
   std::string apply_input(Stage& stage, const char(&input)[N]) {
     // apply_input all input events and concatenate output
@@ -924,3 +987,311 @@ TEST_CASE("Trigger action", "[Stage]") {
 }
 
 //--------------------------------------------------------------------
+
+TEST_CASE("Reorder mappings by match count", "[Stage]") {
+  auto config = R"(
+    ShiftLeft{A} >> X
+    A >> Y
+    B >> Z
+    C D >> W
+    Virtual1 E >> V
+    Any !Control >> Any
+    F >> Virtual1
+  )";
+  Stage stage = create_stage(config);
+  Stage reordered = create_stage(config);
+
+  // pretend later mappings matched more often
+  auto match_counts = std::vector<uint32_t>(reordered.mappings().size());
+  for (auto i = 0u; i < match_counts.size(); ++i)
+    match_counts[i] = static_cast<uint32_t>(i + 1);
+  reordered.reorder_mappings(match_counts);
+  CHECK(reordered.match_counts() == match_counts);
+
+  const auto& order = reordered.mapping_order();
+  REQUIRE(order.size() == stage.mappings().size());
+  // the configured mappings follow the default modifier mappings
+  const auto first = static_cast<int>(order.size()) - 7;
+  const auto position = [&](int index) {
+    return std::distance(order.begin(),
+      std::find(order.begin(), order.end(), first + index));
+  };
+  // mappings which could match the same sequence keep their order
+  CHECK(position(0) < position(1));
+  for (auto i = 0; i < 5; ++i)
+    CHECK(position(i) < position(5));
+  CHECK(position(5) < position(6));
+  // others are moved to the front
+  CHECK(position(2) < position(0));
+  CHECK(position(3) < position(2));
+
+  // outputs stay identical
+  for (auto input : {
+      "+A -A", "+ShiftLeft +A -A -ShiftLeft", "+B +A -B -A", "+C +D -D -C",
+      "+C -C +D -D", "+C +B -B -C", "+E -E", "+F -F +E -E +F -F",
+      "+ShiftLeft +F -F +E -E -ShiftLeft", "+ControlLeft +G -G -ControlLeft",
+      "+G +C -C -G", "+A +A +A -A", "+D +C -C -D" }) {
+    INFO(input);
+    auto expected = KeySequence();
+    auto actual = KeySequence();
+    for (auto event : parse_sequence(input, input + std::strlen(input))) {
+      for (auto output : stage.apply_input(event))
+        expected.push_back(output);
+      for (auto output : reordered.apply_input(event))
+        actual.push_back(output);
+    }
+    CHECK(format_sequence(actual) == format_sequence(expected));
+    CHECK(format_sequence(reordered.sequence()) ==
+          format_sequence(stage.sequence()));
+  }
+
+  // counts of a different configuration are ignored
+  reordered.reorder_mappings({ 1, 2, 3 });
+  CHECK(reordered.match_counts().size() == order.size());
+}
+
+//--------------------------------------------------------------------
+
+#if defined(ENABLE_STATISTICS)
+
+TEST_CASE("Mapping statistics", "[Stage]") {
+  auto config = R"(
+    A B >> X
+    C >> Y
+  )";
+  Stage stage = create_stage(config);
+  const auto first = stage.mappings().size() - 2;
+
+  CHECK(apply_input(stage, "+A") == "");
+  CHECK(apply_input(stage, "-A +B") == "+X");
+  CHECK(apply_input(stage, "-B +C") == "-X +Y");
+
+  const auto& statistics = stage.statistics();
+  REQUIRE(statistics.size() == stage.mappings().size());
+  CHECK(statistics[first].might_matched == 2);
+  CHECK(statistics[first].matched == 1);
+  CHECK(statistics[first + 1].matched == 1);
+  CHECK(statistics[first + 1].tested < statistics[first].tested);
+  for (const auto& mapping : statistics)
+    CHECK(mapping.matcher_steps >= mapping.tested);
+}
+
+//--------------------------------------------------------------------
+
+#endif // ENABLE_STATISTICS
+
+TEST_CASE("Keys which are not mapped", "[Stage]") {
+  auto config = R"(
+    A B >> X
+    ShiftLeft{C} >> !ShiftLeft D
+  )";
+  Stage stage = create_stage(config);
+
+  CHECK(apply_input(stage, "+Y -Y") == "+Y -Y");
+  CHECK(format_sequence(stage.sequence()) == "");
+  CHECK(apply_input(stage, "+Y +Y +Z") == "+Y +Y +Z");
+  CHECK(format_sequence(stage.sequence()) == "#Y #Z");
+  CHECK(apply_input(stage, "+Y") == "+Y");
+  CHECK(format_sequence(stage.sequence()) == "#Z #Y");
+  CHECK(apply_input(stage, "-Z -Y") == "-Z -Y");
+  CHECK(format_sequence(stage.sequence()) == "");
+
+  // released without being pressed
+  CHECK(apply_input(stage, "-Y") == "");
+  CHECK(format_sequence(stage.sequence()) == "");
+
+  // while sequence might match
+  CHECK(apply_input(stage, "+A") == "");
+  CHECK(apply_input(stage, "+Y") == "+A +Y");
+  CHECK(apply_input(stage, "-Y -A") == "-Y -A");
+  CHECK(apply_input(stage, "+Y +A") == "+Y");
+  CHECK(apply_input(stage, "-A +B") == "+X");
+  CHECK(format_sequence(stage.sequence()) == "#Y #B");
+  CHECK(apply_input(stage, "-B -Y") == "-X -Y");
+  CHECK(format_sequence(stage.sequence()) == "");
+
+  // reapplies temporarily released keys
+  CHECK(apply_input(stage, "+ShiftLeft +C") == "+ShiftLeft -ShiftLeft +D");
+  CHECK(apply_input(stage, "+Y") == "+ShiftLeft +Y");
+  CHECK(apply_input(stage, "-Y -C -ShiftLeft") == "-Y -D -ShiftLeft");
+  CHECK(format_sequence(stage.sequence()) == "");
+
+  // no key is forwarded without matching, when a mapping contains Any
+  auto any_config = R"(
+    ControlLeft{Any} >> X
+    A >> B
+  )";
+  Stage any_stage = create_stage(any_config);
+  CHECK(apply_input(any_stage, "+Y -Y") == "+Y -Y");
+  CHECK(apply_input(any_stage, "+ControlLeft +Y") == "+ControlLeft +X");
+  CHECK(apply_input(any_stage, "-Y -ControlLeft") == "-X -ControlLeft");
+  CHECK(apply_input(any_stage, "+A -A") == "+B -B");
+}
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Apply inputs in batches", "[Stage]") {
+  const auto configs = {
+    "A B >> X\n ShiftLeft{C} >> !ShiftLeft D\n",
+    "M R >> A\n M S >> B\n R R >> C\n",
+    "MetaLeft{C} >> MetaLeft{R} ^ C M\n E >> F ^ G\n",
+    "A{B} >> C\n Any >> Any\n",
+    "Virtual1{A} >> B\n C >> Virtual1\n",
+  };
+  const auto input = parse_sequence(
+    "+A +B -B -A +ShiftLeft +C -C -ShiftLeft +M +R -R -M +M +S -S -M "
+    "+R -R +R -R +MetaLeft +C -C -MetaLeft +E +Y -E -Y +C +A -A -C "
+    "+A +Y +A -Y +B -A -B +Z -Z");
+
+  // output after OutputOnRelease is sent before the next input is applied
+  const auto append = [](KeySequence& sequence, const KeySequence& output) {
+    sequence.erase(std::remove_if(sequence.begin(), sequence.end(),
+      [](const KeyEvent& event) {
+        return event.state == KeyState::OutputOnRelease;
+      }), sequence.end());
+    sequence.insert(sequence.end(), output.begin(), output.end());
+  };
+
+  for (auto config : configs)
+    for (auto batch_size = size_t{ 1 }; batch_size <= 5; ++batch_size) {
+      INFO(config << "batch size " << batch_size);
+      auto sequential = create_stage(config);
+      auto batched = create_stage(config);
+
+      for (auto i = size_t{ }; i < input.size(); i += batch_size) {
+        const auto count = std::min(batch_size, input.size() - i);
+        auto expected = KeySequence();
+        for (auto j = i; j < i + count; ++j)
+          append(expected, sequential.apply_input(input[j]));
+
+        CHECK(format_sequence(batched.apply_inputs(&input[i], count)) ==
+          format_sequence(expected));
+        CHECK(format_sequence(batched.sequence()) ==
+          format_sequence(sequential.sequence()));
+        CHECK(batched.is_output_down() == sequential.is_output_down());
+        CHECK(batched.is_sequence_held_back() ==
+          sequential.is_sequence_held_back());
+      }
+    }
+
+  auto stage = create_stage("A >> B\n");
+  CHECK(format_sequence(stage.apply_inputs(nullptr, 0)) == "");
+  CHECK(stage.last_matched_mapping() == -1);
+  const auto events = parse_sequence("+A +C");
+  CHECK(format_sequence(stage.apply_inputs(events.data(), events.size())) ==
+    "+B +C");
+  CHECK(stage.last_matched_mapping() >= 0);
+}
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Many contexts", "[Stage]") {
+  const auto keys = std::string("ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+  auto inputs = std::vector<std::string>();
+  for (auto a : keys)
+    for (auto b : keys)
+      if (a != b)
+        inputs.push_back(std::string(1, a) + "{" + b + "}");
+
+  const auto contexts = 100;
+  const auto get_overridden = [&](int context, int n) {
+    return (context * (n ? 101 : 37) + n * 5) % static_cast<int>(inputs.size());
+  };
+
+  auto config = std::string();
+  for (const auto& input : inputs)
+    config += input + " >> F1\n";
+  for (auto c = 0; c < contexts; ++c) {
+    config += "[title=\"context" + std::to_string(c) + "\"]\n";
+    config += inputs[static_cast<size_t>(get_overridden(c, 0))] + " >> F2\n";
+    config += inputs[static_cast<size_t>(get_overridden(c, 1))] + " >> F3\n";
+  }
+  auto stage = create_stage(config.c_str());
+
+  // the first mappings are the default modifier mappings
+  const auto first = static_cast<int>(stage.mappings().size() - inputs.size());
+  const auto apply_mapping = [&](int index) {
+    const auto& input = stage.mappings()[static_cast<size_t>(first + index)].input;
+    auto sequence = KeySequence();
+    sequence.emplace_back(input[0].key, KeyState::Down);
+    sequence.emplace_back(input[1].key, KeyState::Down);
+    sequence.emplace_back(input[1].key, KeyState::Up);
+    sequence.emplace_back(input[0].key, KeyState::Up);
+    auto output = KeySequence();
+    for (const auto& event : sequence)
+      for (const auto& event : stage.apply_input(event))
+        output.push_back(event);
+    return format_sequence(output);
+  };
+
+  CHECK(apply_mapping(0) == "+F1 -F1");
+  for (auto c = 0; c < contexts; ++c) {
+    INFO("context " << c);
+    stage.activate_override_set(c);
+    CHECK(apply_mapping(get_overridden(c, 0)) == "+F2 -F2");
+    CHECK(apply_mapping(get_overridden(c, 1)) == "+F3 -F3");
+    CHECK(apply_mapping(get_overridden(c + 1, 0)) == "+F1 -F1");
+  }
+  stage.activate_override_set(-1);
+  CHECK(apply_mapping(get_overridden(0, 1)) == "+F1 -F1");
+  stage.activate_override_set(contexts);
+  CHECK(apply_mapping(get_overridden(0, 1)) == "+F1 -F1");
+
+  // blocks without overrides are shared
+  const auto dense_size = stage.mappings().size() *
+    static_cast<size_t>(contexts + 1) * sizeof(const KeySequence*);
+  CHECK(stage.output_tables_size() < dense_size / 4);
+}
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Stage benchmark", "[.benchmark]") {
+  // a unique input sequence of four keys per command
+  const auto sequence = [](int index) {
+    auto string = std::string();
+    for (auto i = 0; i < 4; ++i, index /= 20)
+      string += std::string(1, static_cast<char>('A' + index % 20)) + " ";
+    return string;
+  };
+
+  // random presses and releases of the keys
+  const auto keys = parse_sequence("+A +B +C +D +E +F +G +H +I +J +K +L +M "
+    "+N +O +P +Q +R +S +T +U +V +W +X +Y +Z");
+  auto random = std::mt19937(1);
+  auto input = KeySequence();
+  for (auto i = 0; i < 10000; ++i) {
+    const auto key = keys[random() % keys.size()].key;
+    input.emplace_back(key, KeyState::Down);
+    input.emplace_back(key, KeyState::Up);
+  }
+
+  using Clock = std::chrono::high_resolution_clock;
+  auto counter = CacheMissCounter();
+  for (auto commands = 1000; commands <= 16000; commands *= 2) {
+    auto config = std::string();
+    for (auto i = 0; i < commands; ++i)
+      config += sequence(i) + ">> Shift{X}\n";
+    auto stage = create_stage(config.c_str());
+
+    auto output_events = size_t{ };
+    counter.start();
+    const auto start = Clock::now();
+    for (const auto& event : input) {
+      auto output = stage.apply_input(event);
+      output_events += output.size();
+      stage.reuse_buffer(std::move(output));
+    }
+    const auto duration = std::chrono::duration_cast<
+      std::chrono::nanoseconds>(Clock::now() - start);
+    const auto cache_misses = counter.stop();
+
+    const auto events = static_cast<double>(input.size());
+    std::printf("%6d mappings %10.0f ns/event", commands,
+      static_cast<double>(duration.count()) / events);
+    if (counter.available())
+      std::printf(" %10.1f cache misses/event",
+        static_cast<double>(cache_misses) / events);
+    std::printf("\n");
+    CHECK(output_events > 0);
+  }
+}
@@ -0,0 +1,150 @@
+
+#include "test.h"
+#include "config/Regex.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+  const auto patterns = {
+    "Title", "^Title$", "Title1|Title2", "^(Visual Studio Code|Code OSS)$",
+    "fire(fox)?", "firefox[123]*x{1,3}", "^Base\\d+$", "[a-c]+\\.[^ ]{2,}",
+    "a*b+c?", "(ab|a)(bc|c)", "\\bcode\\b", "\\Bode", "x{2}y{0,2}z{1,}",
+    "[\\w-]+@[\\w.]+", "\\s+\\S", "\\x41\\u0042", "a.c", "(?:a|b)*c",
+    "[]", "^$", "", "()*", "(a*)*b", "[-a]", "[a-]", "\\.\\*\\/",
+  };
+  const auto texts = {
+    "", "Title", "Title1", "title2", "_Title_", "Visual Studio Code",
+    "code oss", "Code OSS - file", "firefox", "Firefox312xx", "FIREFOXxxx",
+    "Base100", "Base100_", "abc.de", "ABC.DE", "aaabbb", "abc", "a code b",
+    "decode", "xxyyz", "XXZ", "mail-me@host.org", "  x", "AB", "a\nc",
+    "abababc", "b", "-", ".*/", "unicode \xc3\xa4\xc3\xb6",
+  };
+
+  bool std_regex_search(const char* pattern, bool icase, const char* text) {
+    auto type = std::regex::ECMAScript;
+    if (icase)
+      type |= std::regex::icase;
+    return std::regex_search(text, std::regex(pattern, type));
+  }
+} // namespace
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Regex matches std::regex", "[Regex]") {
+  for (auto icase : { false, true })
+    for (auto pattern : patterns) {
+      const auto regex = Regex(pattern, icase);
+      CHECK(!regex.is_fallback());
+      for (auto text : texts) {
+        INFO(pattern << " " << text << " " << icase);
+        CHECK(regex.search(text) == std_regex_search(pattern, icase, text));
+      }
+    }
+}
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Regex fallback", "[Regex]") {
+  // unsupported constructs are passed to std::regex
+  CHECK(Regex("(a)\\1", false).is_fallback());
+  CHECK(Regex("a(?=b)", false).is_fallback());
+  CHECK(Regex("a(?!b)", false).is_fallback());
+  CHECK(Regex("[[:alpha:]]", false).is_fallback());
+  CHECK(Regex("\\cJ", false).is_fallback());
+  CHECK(Regex("a{3000}b{3000}", false).is_fallback());
+
+  CHECK(Regex("(a)\\1", false).search("xaa"));
+  CHECK(!Regex("(a)\\1", false).search("xab"));
+  CHECK(Regex("a(?=b)", false).search("ab"));
+  CHECK(!Regex("a(?=b)", false).search("ac"));
+
+  // invalid expressions still throw
+  CHECK_THROWS(Regex("(a", false));
+  CHECK_THROWS(Regex("a{2,1}", false));
+  CHECK_THROWS(Regex("[b-a]", false));
+}
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Regex set", "[Regex]") {
+  auto set = RegexSet();
+  CHECK(set.empty());
+  for (auto pattern : patterns)
+    set.add(Regex(pattern, false));
+  set.add(Regex("(a)\\1", false));
+  CHECK(!set.empty());
+
+  auto matched = std::vector<char>();
+  for (auto text : texts) {
+    set.search(text, &matched);
+    REQUIRE(matched.size() == patterns.size() + 1);
+    auto i = 0u;
+    for (auto pattern : patterns) {
+      INFO(pattern << " " << text);
+      CHECK((matched[i++] != 0) == std_regex_search(pattern, false, text));
+    }
+    CHECK((matched[i] != 0) == std_regex_search("(a)\\1", false, text));
+  }
+}
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Regex long text", "[Regex]") {
+  // std::regex recursion overflows the stack on such texts
+  const auto text = std::string(1000000, 'a') + "b";
+  CHECK(Regex("(a|b)*b$", false).search(text));
+  CHECK(!Regex("(a|b)*c", false).search(text));
+}
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Regex benchmark", "[.benchmark]") {
+  using Clock = std::chrono::high_resolution_clock;
+  const auto measure = [](const char* name, auto&& function) {
+    const auto repetitions = 10000;
+    const auto start = Clock::now();
+    for (auto i = 0; i < repetitions; ++i)
+      function();
+    const auto duration = std::chrono::duration_cast<
+      std::chrono::nanoseconds>(Clock::now() - start);
+    std::printf("%-28s %10.0f ns\n", name,
+      static_cast<double>(duration.count()) / repetitions);
+  };
+
+  const auto pattern = "^(Visual Studio Code|Code OSS)$";
+  const auto text = "main.cpp - keymapper - Visual Studio Code";
+  auto std_regex = std::regex(pattern, std::regex::ECMAScript);
+  auto regex = Regex(pattern, false);
+  auto std_regexes = std::vector<std::regex>();
+  auto set = RegexSet();
+  for (auto pattern : patterns) {
+    std_regexes.emplace_back(pattern, std::regex::ECMAScript);
+    set.add(Regex(pattern, false));
+  }
+  auto matched = std::vector<char>();
+
+  measure("std::regex construct", [&]() {
+    std_regex = std::regex(pattern, std::regex::ECMAScript); });
+  measure("Regex construct", [&]() { regex = Regex(pattern, false); });
+
+  // both engines have to find the same number of matches
+  auto std_matches = 0;
+  auto matches = 0;
+  measure("std::regex search", [&]() {
+    std_matches += std::regex_search(text, std_regex); });
+  measure("Regex search", [&]() { matches += regex.search(text); });
+  CHECK(matches == std_matches);
+
+  std_matches = 0;
+  matches = 0;
+  measure("std::regex search all", [&]() {
+    for (const auto& std_regex : std_regexes)
+      std_matches += std::regex_search(text, std_regex); });
+  measure("RegexSet search all", [&]() {
+    set.search(text, &matched);
+    matches += static_cast<int>(
+      std::count_if(matched.begin(), matched.end(),
+        [](char m) { return m != 0; })); });
+  CHECK(matches == std_matches);
+}
@@ -0,0 +1,90 @@
+#include "test.h"
+#include "config/ParseConfig.h"
+#include "config/CreateStage.h"
+#include "config/FindHeldBackSequences.h"
+#include <map>
+
+namespace {
+  Config parse_config(const char* config) {
+    static auto parse = ParseConfig();
+    auto stream = std::stringstream(config);
+    return parse(stream, false);
+  }
+
+  std::map<std::string, int> find_held_back(const Stage& stage) {
+    auto held_back = std::map<std::string, int>();
+    for (const auto& [sequence, index] : find_held_back_sequences(stage))
+      held_back.emplace(format_sequence(sequence), index);
+    return held_back;
+  }
+
+  std::string apply_input(Stage& stage, const KeySequence& input) {
+    auto output = KeySequence();
+    for (const auto& event : input) {
+      const auto events = stage.apply_input(event);
+      output.insert(output.end(), events.begin(), events.end());
+    }
+    return format_sequence(output);
+  }
+} // namespace
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Held back sequences", "[FindHeldBackSequences]") {
+  auto config = R"(
+    A >> X
+    B C >> Y
+    ShiftLeft{D} >> Z
+  )";
+  const auto stage = create_stage(parse_config(config));
+  const auto held_back = find_held_back(*stage);
+  REQUIRE(held_back.size() == 2);
+  CHECK(held_back.at("+B") == 1);
+  CHECK(held_back.at("+ShiftLeft") == 2);
+
+  // the first mapping which might match is reported
+  auto result = MatchResult{ };
+  CHECK(find_first_match(*stage, parse_sequence("+B"), &result) == 1);
+  CHECK(result == MatchResult::might_match);
+  CHECK(find_first_match(*stage, parse_sequence("+A"), &result) == 0);
+  CHECK(result == MatchResult::match);
+  CHECK(find_first_match(*stage, parse_sequence("+E"), &result) == -1);
+  CHECK(result == MatchResult::no_match);
+}
+
+//--------------------------------------------------------------------
+
+TEST_CASE("Held back sequences of contexts", "[FindHeldBackSequences]") {
+  auto config = R"(
+    A B >> X
+
+    [class="app1"]
+    A B >> W
+
+    [class="app2"]
+    D E >> Z
+  )";
+  const auto parsed = parse_config(config);
+  REQUIRE(parsed.commands.size() == 2);
+  REQUIRE(parsed.contexts.size() == 2);
+  const auto stage = create_stage(parsed);
+
+  // mappings which are only defined in a context hold back in all contexts
+  const auto held_back = find_held_back(*stage);
+  REQUIRE(held_back.size() == 2);
+  CHECK(held_back.at("+A") == 0);
+  CHECK(held_back.at("+D") == 1);
+
+  // the override sets of the contexts are created
+  REQUIRE(stage->override_sets().size() == 2);
+  const auto input_ab = parse_sequence("+A +B -B -A");
+  const auto input_de = parse_sequence("+D +E -E -D");
+  CHECK(apply_input(*stage, input_ab) == "+X -X");
+  CHECK(apply_input(*stage, input_de) == "+D +E -E -D");
+  stage->activate_override_set(0);
+  CHECK(apply_input(*stage, input_ab) == "+W -W");
+  CHECK(apply_input(*stage, input_de) == "+D +E -E -D");
+  stage->activate_override_set(1);
+  CHECK(apply_input(*stage, input_ab) == "+X -X");
+  CHECK(apply_input(*stage, input_de) == "+Z -Z");
+}
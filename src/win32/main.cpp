@@ -2,6 +2,7 @@
 #include "Settings.h"
 #include "ConfigFile.h"
 #include "FocusedWindow.h"
+#include "config/FindContext.h"
 #include "runtime/Stage.h"
 #include "LimitSingleInstance.h"
 #include "common.h"
@@ -17,6 +18,7 @@ namespace {
   ConfigFile g_config_file;
   FocusedWindowPtr g_focused_window;
   std::unique_ptr<Stage> g_stage;
+  FindContext g_find_context;
   bool g_was_inaccessible;
   unsigned int g_update_configuration_count;
   
@@ -117,6 +119,7 @@ void reset_state() {
     }
   }
   g_stage = std::make_unique<Stage>(std::move(mappings), std::move(override_sets));
+  g_find_context = FindContext(config);
   g_focused_window = create_focused_window();
 }
 
@@ -186,7 +189,7 @@ bool update_focused_window() {
   verbose("  class = '%s'", get_class(*g_focused_window).c_str());
   verbose("  title = '%s'", get_title(*g_focused_window).c_str());
 
-  const auto override_set = find_context(g_config_file.config(),
+  const auto override_set = g_find_context(
       get_class(*g_focused_window),
       get_title(*g_focused_window));
 